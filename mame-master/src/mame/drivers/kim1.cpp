@@ -51,11 +51,285 @@ When a key is pressed the corresponding input to PA0-PA6 is set low and the KIM-
 software reads this signal. The KIM-1 software sends an output signal to PA0-PA6
 and the corresponding segments of an LED are illuminated.
 
+Text extraction
+===============
+KVOS draws its characters into 8x8 cells of the bitmap, so the screen can be
+read back as a 40x25 text grid. Each cell is packed into a 64-bit word (one
+byte per pixel row) and looked up in a glyph table; blank cells read as a
+space and cells with no known glyph read as '?'. The KVOS ROM keeps its font
+in a packed form, so the table is filled by text_learn() from a screen whose
+contents are known; a control channel client does this with
+kim1_text_learn() and reads rows back with kim1_text_row() (see Control
+channel). Only cell rows written since the previous extraction are matched
+again.
+
+Monitor HLE
+===========
+With the "Monitor HLE" option on, the 6530-002 display and keypad routines
+are done natively instead of being interpreted:
+    1EFE  AK      any key down? (A = 0 if none)
+    1F19  SCAND   display the byte at (FA) with the address in FA/FB
+    1F1F  SCANDS  display FB FA F9 on the six LEDs
+    1F6A  GETKEY  return the key code in A, 15 if none
+The opcode fetch at the routine's entry is caught by a read handler over the
+routine area, the work is done directly on the LED outputs and keypad rows,
+and the CPU is handed an RTS with A/X/Y and N/Z as the ROM would leave
+them.
+The cycles the ROM code would have taken are charged to the CPU, so RIOT
+timers and the rest of the machine see the same timing.
+
+KVOS native routines
+====================
+KVOS was written for the MTU K-1008 Visible Memory at A000-BFFF, so the video
+window is also visible there. Hot KVOS routines can be replaced by native
+code registered with kvos_register(); the "KVOS native routines" option
+selects how they are used:
+    Off           the 6502 code runs as normal
+    Real timing   native code runs, charged the 6502 routine's cycles
+    Fast          native code runs, charged only the returning RTS
+    Verify        the 6502 code runs, and its registers and memory writes on
+                  return are compared with a shadow run of the native code
+Entries are caught like the monitor HLE, by a read handler over the ROM that
+looks at opcode fetches. In verify mode the check happens at the fetch of the
+return address, so only calls made from KVOS itself are checked.
+Mismatches are logged as they happen, and a count is printed at exit.
+Registered routines:
+    F88A  plot    set or clear the pixel at (FB),FD depending on bit 6 of FA
+    F956  clear   zero the frame buffer from A000 up to the end in 1632/1633
+
+Host-call port
+==============
+For test programs, the "Host-call port" option maps a paravirtual device at
+E000-E00F (see machine/kim1_hostcall.cpp). Guest code can print to stdout,
+end the run with a status as soon as a test finishes, read test vectors from
+host files and read the cycle count.
+
+Host directory bridge
+=====================
+The "Host directory" option maps a bridge at E020-E02F (see
+machine/kim1_hostfs.cpp) that lets the guest open, read and write files in
+the host's kim1_host directory by name, moving data straight to and from
+KIM-1 memory. It is opt-in as it gives the guest access to host files.
+
+Banked RAM
+==========
+The "Banked RAM" option adds a card with 16 banks of 8 KB, seen one at a
+time at 8000-9FFF. The bank is chosen by the low four bits of the latch at
+E030, which reads back. Switching only repoints the bank, so it costs the
+same whatever is in the banks.
+
+Memory arena
+============
+The driver's own RAM comes from one block per machine. This includes low
+memory, the 6530 RAM, video, colour, expansion RAM and the banked RAM card.
+The pieces are ordered hottest first and each starts on a 64-byte line.
+Its size is printed with -verbose. The ROM, bitmaps and devices belong to
+the core and are allocated by it.
+
+Block storage
+=============
+The "Block storage" option maps a card at E010-E01F (see
+machine/kim1_blkdev.cpp). It moves 256-byte sectors between a host image
+file, mounted as -hard, and KIM-1 memory by DMA.
+
+DMA controller
+==============
+The "DMA controller" option maps a card at E040-E047 (see
+machine/kim1_dma.cpp) that copies blocks between any of RAM, the video
+window and banked RAM, marking the video rows it writes as changed. The CPU
+is held for a programmable number of cycles per byte, or not at all in turbo
+mode, and the card can interrupt the CPU when the copy is done.
+
+Math coprocessor
+================
+The "Math coprocessor" option maps an Am9511A-style arithmetic processor at
+E050-E051 (see machine/kim1_apu.cpp). It does 16- and 32-bit integer and
+32-bit floating point arithmetic and functions through a byte-wide operand
+stack. The work is done natively; the "Math coprocessor timing" option
+chooses between the Am9511A's execution times at 2 MHz and none at all.
+
+Performance counters
+====================
+The "Performance counters" option maps a card at E060-E07F (see
+machine/kim1_perf.cpp) that gives the guest free-running 32-bit counts of
+CPU cycles, instructions, interrupts taken, video window writes and RIOT
+port accesses, each latched when its low byte is read, so programs can
+profile themselves. Instructions are counted from the CPU's SYNC line.
+Nothing is counted while the card is unmapped.
+
+Coprocessor
+===========
+The "Coprocessor" option adds a second 6502 card. It has 8 KB of private
+RAM at 0000-1FFF and shares a 256-byte mailbox with the main CPU, seen at
+E100-E1FF by the main CPU and at FF00-FFFF by the coprocessor, so its
+vectors come from the top of the mailbox. The main CPU's register at E200
+writes control (bit 0 = run, bit 1 = interrupt the coprocessor) and reads
+the coprocessor's doorbell, clearing it. The coprocessor rings the doorbell
+by writing 2000 and acknowledges its interrupt by reading 2000. The
+coprocessor is held in reset until started, so the main CPU can put a loader
+in the mailbox first.
+
+The CPUs only synchronise when the control register or doorbell is used, so
+handshakes should go through them rather than by polling the mailbox.
+
+Serial link
+===========
+The "Serial link" option joins two KIM-1s, each run as its own process, on
+their TTY lines: PB0 of one drives PA7 of the other. The link is a shared
+object, /kim1.link or the name in the KIM1_LINK environment variable,
+holding a lock-free ring of timestamped line changes each way (see
+machine/kim1_shm.cpp). One machine is set to side A and the other to
+side B. Neither runs more than 1 ms of emulated time ahead of the other,
+which is also the latency of the line, so the link behaves the same however
+the host schedules the two processes. A link joins exactly two machines;
+give each pair its own link name. If one machine stops for a second
+(paused, say), the other can no longer keep in step with it, so it closes
+the link for good with a warning and the line reads as idle from then on.
+
+Differential check
+==================
+To check the fast paths (monitor HLE, KVOS native routines and the like)
+against the reference ones, run two copies of the same setup, one with the
+"Differential check" option set to reference and the fast paths off, the
+other set to fast paths with them on. Native routines must charge real
+timing, or the cycle counts will differ. Once a frame each publishes its
+CPU registers, cycle count and memory to a shared object, /kim1.diff or the
+name in KIM1_DIFF (see machine/kim1_shm.cpp), and they compare. Only pages
+that have changed are copied and hashed: video pages by the row serials,
+others against the last snapshot. Then one hash per page is compared. A
+native routine finishes at once where the ROM takes time, so a frame's check
+is made at the first instruction from there on that is outside ROM. While a
+CPU is in ROM, its opcode fetches are watched for an RTS, RTI, JMP or JSR
+that leaves, and the check follows that instruction; both copies come out of
+a routine on the same cycle, so they stop at the same point. On the first
+difference both copies report registers and the first differing byte, and
+exit.
+
+Snapshot store
+==============
+For fuzz corpora and rewind, the "Snapshot store" option maps a port at
+E080-E082 that keeps snapshots of the machine in one file,
+<state>/kim1/snapshots.kds (or the name in KIM1_SNAP) (see
+machine/kim1_snap.cpp). A snapshot is the RAM, video, attribute and banked
+RAM plus the CPU registers. Writing 01 to E080 starts the file with the
+machine as it is now as the base. 02 adds a snapshot and returns its index
+in E081-E082; 03 restores the snapshot at that index. E080 reads 00 on
+success, 80 on error. Each snapshot is stored as its XOR with the base,
+coded as zero and literal runs, so a typical one takes well under 1 KB
+and can be read back on its own in microseconds. A snapshot is taken once
+the store that asked for it has finished, and a restored machine carries on
+from the next instruction, whichever store was used. The RIOTs and cards
+are not part of a snapshot: their timers, ports, interrupts and registers
+stay as they are at the restore, so a program should restore with them idle.
+
+Warm-boot cache
+===============
+With the "Warm-boot cache" option on, the first run saves a state at a boot
+point to <state>/kim1/warmboot.sta, and later runs load it at once instead
+of going through the monitor and KVOS start-up. The boot point is set by
+KIM1_WARMBOOT_AT: "pc=XXXX" for the first opcode fetch from XXXX, or a cycle
+count (default 1000000). Next to the state, warmboot.key holds the SHA1 of
+the ROMs, the machine options and the boot point; if any of them changes,
+the cached state is ignored and a new one is saved. The key is removed
+before a save and written only once the state is on disk.
+
+Checkpoints
+===========
+For long soak runs, the "Checkpoints" option saves a full state every
+KIM1_CHECKPOINT_SECS of emulated time (default 60) and on SIGTERM, after
+which it exits. Checkpoints alternate between <state>/kim1/checkpoint-0.sta
+and checkpoint-1.sta. checkpoint.key names the last one known to be
+complete, with the same ROM and options key as the warm-boot cache. A
+restart with the same options resumes from it. Saving is MAME's own state
+save, done between timeslices. Input recordings and AVI/MNG captures are
+written by the core and are not resumed.
+
+Control channel
+===============
+Test services can drive the machine from their own code through
+src/tools/libkim1, a small C library that starts `mame kim1 -video none`.
+Each instance runs in a process of its own. The library passes the name
+of a shared control object in KIM1_CTL. The machine then stops before
+its first instruction and runs only when asked to step a number of
+cycles. While stopped, it reads and writes memory, sets the PC, holds
+keypad keys, and takes or restores a driver snapshot, as in the
+snapshot store. Memory is read with side effects disabled, as the
+debugger reads it, so looking at a register does not acknowledge it.
+The video RAM at A000-BFFF is copied into the object whenever it
+changes. The screen can also be read as rows of text, once its glyphs
+have been taught from a screen whose text is known.
+A stopped machine waits for the next request inside the control timer
+callback, so no emulated time passes between requests. The wait ends if
+the client detaches or dies.
+
+The machine can also run until an event happens instead of polling for
+it. The events are an opcode fetch from an address, the LEDs showing a
+string of hex digits, or a write to a range of video RAM, each with an
+optional cycle limit. It is stopped after the instruction that caused the
+event, found by the LED, video and PC hooks as it happens. A client can
+also post a wait and poll for it later, so one thread can drive many
+machines. libkim1_co.h builds C++20 coroutines on that: a test suspends
+at co_await pc_reached(0x1c4f) or co_await led_shows("0200") and is
+resumed by a runner that polls all its machines in turn.
+
+Shared memory
+=============
+With the "Shared memory" option on, the 2000-3FFF expansion RAM and the video
+window are moved into a POSIX shared-memory object named /kim1.<pid> (see
+machine/kim1_shm.cpp), so host tools can read and write them in place. The
+object's sequence counter is odd while a frame is being emulated and even
+between frames. Save states still go through the original memory, which is
+brought up to date before saving and copied back after loading.
+
+Battery-backed RAM
+==================
+The "Battery-backed RAM" option keeps 2000-3FFF in nvram/kim1/ram2000.map,
+mapped straight into the address space, so KVOS settings survive a restart
+with no cost per write. The file is flushed and marked clean on exit; if the
+mark is missing at the next start, the previous run crashed and a warning is
+shown (the contents are still used). When both this and shared memory are
+on, the shared object carries only the video window, since host tools can
+map the NVRAM file themselves.
+
+Colour attributes
+=================
+The display is monochrome by default. With the "Display" option set to colour
+attributes, each 8x8 cell of the bitmap takes its colours from one byte of
+the attribute RAM at 6000-63E7, stored row by row after the bitmap:
+    bits 0-2  foreground pen, inverted (so cleared RAM is white on black)
+    bits 4-6  background pen
+The pens are the eight 3-bit RGB palette entries, which never change. Every
+fg/bg pair in use gets a table of all 256 bitmap bytes expanded to eight RGB
+pixels, so drawing costs one table copy per byte.
+
+Thumbnail
+=========
+For monitoring many machines at once, thumbnail_update() keeps an 80x50
+greyscale copy of the screen, each byte being the number of lit pixels in a
+4x4 block scaled to 0-255. Four bitmap rows are combined into one 32-bit word
+so a whole byte column of blocks is counted with two popcounts, and only
+blocks covering rows written since the last call are recomputed. It is
+updated every frame while a control channel is open, and libkim1 clients
+read it with kim1_thumbnail().
+
+65C02
+=====
+kim1c is the same machine with a 65C02 in place of the NMOS 6502, for
+software that uses BRA, STZ, PHX/PLX, (zp) addressing and the rest of the
+CMOS additions. The core takes the 65C02's extra cycle for decimal mode
+ADC/SBC. The monitor ROM runs unchanged. The monitor HLE and KVOS native
+routines charge NMOS cycle counts, so kim1c ignores those options and always
+runs the ROM code.
+
 TODO:
 - LEDs should be dark at startup (RS key to activate)
 - hook up Single Step dip switch
 - slots for expansion & application ports
 - add TTY support
+- batched lockstep running of many instances (structure-of-arrays CPU state
+  stepped in SIMD lanes) needs an interpreter of its own: the 6502 core is
+  the shared M6502 device and MAME runs one machine per process, so nothing
+  here can step instances together
 ******************************************************************************/
 
 #include "emu.h"
@@ -87,23 +361,31 @@ static ADDRESS_MAP_START(kim1_map, AS_PROGRAM, 8, kim1_state)
 	//AM_RANGE(0x17c0, 0x17ff) AM_MIRROR(0xe000) AM_RAM
 	//AM_RANGE(0x1800, 0x1bff) AM_MIRROR(0xe000) AM_ROM
 	//AM_RANGE(0x1c00, 0x1fff) AM_MIRROR(0xe000) AM_ROM
-	AM_RANGE(0x0000, 0x03ff)  AM_RAM
 	AM_RANGE(0x1700, 0x173f)  AM_DEVREADWRITE("miot_u3", mos6530_device, read, write )
 	AM_RANGE(0x1740, 0x177f)  AM_DEVREADWRITE("miot_u2", mos6530_device, read, write )
-	AM_RANGE(0x1780, 0x17bf)  AM_RAM
-	AM_RANGE(0x17c0, 0x17ff)  AM_RAM
 	AM_RANGE(0x1800, 0x1bff)  AM_ROM
 	AM_RANGE(0x1c00, 0x1fff)  AM_ROM
-	AM_RANGE(0x2000, 0x3fff)  AM_RAM
+	AM_RANGE(0x2000, 0x3fff)  AM_RAM AM_SHARE("ram")
 	// <hack> mkelsey/20170806@0839 after seeing the riot 6530's use devreadwrite and
 	// being confused by what AM_MIRROR actually does, I deviated to remove the
 	// separate AM_START previously below and consolidate in to a similar method
 	// as used with the riot's since that's what the MAMEDEV online resources
 	// also indicated was the right way to implement peripheral space memory.
 	AM_RANGE(0x4000, 0x5fff)   AM_READWRITE(missile_r, missile_w) AM_SHARE("videoram")
+	AM_RANGE(0x6000, 0x63ff)   AM_RAM AM_SHARE("colorram")
+	AM_RANGE(0x8000, 0x9fff)   AM_RAMBANK("xram")
+	AM_RANGE(0xa000, 0xbfff)   AM_READWRITE(missile_r, missile_w) AM_SHARE("videoram")
+	AM_RANGE(0xe030, 0xe030)   AM_READWRITE(xram_bank_r, xram_bank_w)
 	AM_RANGE(0xf000, 0xffff)  AM_ROM
 ADDRESS_MAP_END
 
+static ADDRESS_MAP_START(kim1_copro_map, AS_PROGRAM, 8, kim1_state)
+	ADDRESS_MAP_GLOBAL_MASK(0xffff)
+	AM_RANGE(0x0000, 0x1fff)  AM_RAM
+	AM_RANGE(0x2000, 0x2000)  AM_READWRITE(copro_ack_r, copro_doorbell_w)
+	AM_RANGE(0xff00, 0xffff)  AM_RAM AM_SHARE("mailbox")
+ADDRESS_MAP_END
+
 // RS and ST key input
 INPUT_CHANGED_MEMBER(kim1_state::trigger_reset)
 {
@@ -161,24 +443,89 @@ static INPUT_PORTS_START( kim1 )
 	PORT_BIT( 0x04, 0x00, IPT_UNUSED )
 	PORT_BIT( 0x02, 0x00, IPT_UNUSED )
 	PORT_BIT( 0x01, 0x00, IPT_UNUSED )
+
+	PORT_START("CONFIG")
+	PORT_CONFNAME( 0x01, 0x00, "Text capture" )
+	PORT_CONFSETTING(    0x00, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x01, "Log changed rows" )
+	PORT_CONFNAME( 0x02, 0x00, "Display" )
+	PORT_CONFSETTING(    0x00, "Monochrome" )
+	PORT_CONFSETTING(    0x02, "Colour attributes" )
+	PORT_CONFNAME( 0x04, 0x00, "Monitor HLE" )
+	PORT_CONFSETTING(    0x00, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x04, DEF_STR( On ) )
+	PORT_CONFNAME( 0x18, 0x00, "KVOS native routines" )
+	PORT_CONFSETTING(    0x00, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x08, "Real timing" )
+	PORT_CONFSETTING(    0x10, "Fast" )
+	PORT_CONFSETTING(    0x18, "Verify" )
+	PORT_CONFNAME( 0x20, 0x00, "Host-call port" )
+	PORT_CONFSETTING(    0x00, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x20, "E000" )
+	PORT_CONFNAME( 0x40, 0x00, "Shared memory" )
+	PORT_CONFSETTING(    0x00, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x40, DEF_STR( On ) )
+	PORT_CONFNAME( 0x80, 0x00, "Battery-backed RAM" )
+	PORT_CONFSETTING(    0x00, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x80, "2000-3FFF" )
+	PORT_CONFNAME( 0x100, 0x000, "Host directory" )
+	PORT_CONFSETTING(    0x000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x100, "E020" )
+	PORT_CONFNAME( 0x200, 0x000, "Math coprocessor timing" )
+	PORT_CONFSETTING(    0x000, "Real timing" )
+	PORT_CONFSETTING(    0x200, "Instant" )
+	PORT_CONFNAME( 0xc00, 0x000, "Serial link" )
+	PORT_CONFSETTING(    0x000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x400, "Side A" )
+	PORT_CONFSETTING(    0x800, "Side B" )
+	PORT_CONFNAME( 0x3000, 0x0000, "Differential check" )
+	PORT_CONFSETTING(    0x0000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x1000, "Reference" )
+	PORT_CONFSETTING(    0x2000, "Fast paths" )
+	PORT_CONFNAME( 0x4000, 0x0000, "Snapshot store" )
+	PORT_CONFSETTING(    0x0000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x4000, "E080" )
+	PORT_CONFNAME( 0x8000, 0x0000, "Warm-boot cache" )
+	PORT_CONFSETTING(    0x0000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x8000, DEF_STR( On ) )
+	PORT_CONFNAME( 0x10000, 0x00000, "Checkpoints" )
+	PORT_CONFSETTING(    0x00000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x10000, DEF_STR( On ) )
+	PORT_CONFNAME( 0x20000, 0x00000, "Block storage" )
+	PORT_CONFSETTING(    0x00000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x20000, "E010" )
+	PORT_CONFNAME( 0x40000, 0x00000, "Banked RAM" )
+	PORT_CONFSETTING(    0x00000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x40000, "8000, latch E030" )
+	PORT_CONFNAME( 0x80000, 0x00000, "DMA controller" )
+	PORT_CONFSETTING(    0x00000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x80000, "E040" )
+	PORT_CONFNAME( 0x100000, 0x000000, "Math coprocessor" )
+	PORT_CONFSETTING(    0x000000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x100000, "E050" )
+	PORT_CONFNAME( 0x200000, 0x000000, "Performance counters" )
+	PORT_CONFSETTING(    0x000000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x200000, "E060" )
+	PORT_CONFNAME( 0x400000, 0x000000, "Coprocessor" )
+	PORT_CONFSETTING(    0x000000, DEF_STR( Off ) )
+	PORT_CONFSETTING(    0x400000, "E100" )
 INPUT_PORTS_END
 
 // Read from keyboard
 READ8_MEMBER( kim1_state::kim1_u2_read_a )
 {
+	perf_count(kim1_perf_device::COUNTER_RIOT_ACCESSES);
+
 	uint8_t data = 0xff;
 
-	switch( ( m_u2_port_b >> 1 ) & 0x0f )
+	if ( ( ( m_u2_port_b >> 1 ) & 0x0f ) < 3 )
+		data = keypad_row( ( m_u2_port_b >> 1 ) & 0x0f );
+
+	/* TTY in from the serial link */
+	if ( m_link.is_open() )
 	{
-	case 0:
-		data = m_row0->read();
-		break;
-	case 1:
-		data = m_row1->read();
-		break;
-	case 2:
-		data = m_row2->read();
-		break;
+		m_link.receive( link_now(), m_link_rx );
+		data = ( data & 0x7f ) | ( m_link_rx ? 0x80 : 0 );
 	}
 	return data;
 }
@@ -186,21 +533,37 @@ READ8_MEMBER( kim1_state::kim1_u2_read_a )
 // Write to 7-Segment LEDs
 WRITE8_MEMBER( kim1_state::kim1_u2_write_a )
 {
+	perf_count(kim1_perf_device::COUNTER_RIOT_ACCESSES);
+
 	uint8_t idx = ( m_u2_port_b >> 1 ) & 0x0f;
 
 	if ( idx >= 4 && idx < 10 )
 	{
 		if ( data & 0x80 )
-		{
-			output().set_digit_value( idx-4, data & 0x7f );
-			m_led_time[idx - 4] = 15;
-		}
+			led_set( idx - 4, data );
+	}
+}
+
+void kim1_state::led_set(int digit, uint8_t segments)
+{
+	output().set_digit_value( digit, segments & 0x7f );
+	m_led_time[digit] = 15;
+	m_led_segments[digit] = segments & 0x7f;
+
+	if ( m_wait_kind == WAIT_LEDS )
+	{
+		for ( int i = 0; i < 6; i++ )
+			if ( m_wait_leds[i] != 0xff && m_wait_leds[i] != m_led_segments[i] )
+				return;
+		wait_fired();
 	}
 }
 
 // Load from cassette
 READ8_MEMBER( kim1_state::kim1_u2_read_b )
 {
+	perf_count(kim1_perf_device::COUNTER_RIOT_ACCESSES);
+
 	if ( m_riot2->portb_out_get() & 0x20 )
 		return 0xFF;
 
@@ -210,8 +573,18 @@ READ8_MEMBER( kim1_state::kim1_u2_read_b )
 // Save to cassette
 WRITE8_MEMBER( kim1_state::kim1_u2_write_b )
 {
+	perf_count(kim1_perf_device::COUNTER_RIOT_ACCESSES);
+
 	m_u2_port_b = data;
 
+	/* TTY out to the serial link */
+	if ( m_link.is_open() && ( data & 0x01 ) != m_link_tx )
+	{
+		m_link_tx = data & 0x01;
+		if ( !m_link.send( link_now() + LINK_LOOKAHEAD, m_link_tx ) )
+			logerror("serial link full, line change dropped\n");
+	}
+
 	if ( data & 0x20 )
 		/* cassette write/speaker update */
 		m_cass->output(( data & 0x80 ) ? -1.0 : 1.0 );
@@ -219,6 +592,20 @@ WRITE8_MEMBER( kim1_state::kim1_u2_write_b )
 	/* Set IRQ when bit 7 is cleared */
 }
 
+// Count interrupts for the performance counter card
+IRQ_CALLBACK_MEMBER( kim1_state::kim1_irq_ack )
+{
+	perf_count(kim1_perf_device::COUNTER_IRQS);
+	return 0;
+}
+
+// Count instructions for the performance counter card
+WRITE_LINE_MEMBER( kim1_state::kim1_sync_w )
+{
+	if ( m_perf_mapped )
+		m_perf->sync_w( state );
+}
+
 TIMER_DEVICE_CALLBACK_MEMBER(kim1_state::kim1_cassette_input)
 {
 	double tap_val = m_cass->input();
@@ -236,6 +623,23 @@ TIMER_DEVICE_CALLBACK_MEMBER(kim1_state::kim1_cassette_input)
 		m_cassette_high_count++;
 }
 
+// Keep within the serial link's lookahead of the other machine: the next
+// period is only run once the peer is too far on to send into it. A peer
+// that stalls can no longer be kept in step, so the link is broken rather
+// than run on with changes arriving in the past.
+TIMER_CALLBACK_MEMBER(kim1_state::kim1_link_sync)
+{
+	uint64_t now = link_now();
+	m_link.publish( now );
+	if ( !m_link.wait_for_peer( now + LINK_PERIOD, LINK_LOOKAHEAD ) )
+	{
+		osd_printf_warning("Serial link peer stalled; link closed\n");
+		m_link.close();
+		m_link_timer->reset();
+		m_link_broken = true;
+	}
+}
+
 // Blank LEDs during cassette operations
 TIMER_DEVICE_CALLBACK_MEMBER(kim1_state::kim1_update_leds)
 {
@@ -246,7 +650,10 @@ TIMER_DEVICE_CALLBACK_MEMBER(kim1_state::kim1_update_leds)
 		if ( m_led_time[i] )
 			m_led_time[i]--;
 		else
+		{
 			output().set_digit_value( i, 0 );
+			m_led_segments[i] = 0;
+		}
 	}
 }
 
@@ -256,6 +663,72 @@ void kim1_state::machine_start()
 	save_item(NAME(m_u2_port_b));
 	save_item(NAME(m_311_output));
 	save_item(NAME(m_cassette_high_count));
+
+	arena_allocate();
+	m_xram_bank->configure_entries(0, XRAM_BANKS, m_xram, XRAM_BANK_SIZE);
+	m_xram_latch = 0;
+	save_pointer(NAME(m_xram), XRAM_BANKS * XRAM_BANK_SIZE);
+	save_item(NAME(m_xram_latch));
+	save_item(NAME(m_copro_control));
+	save_item(NAME(m_copro_status));
+	machine().save().register_postload(save_prepost_delegate(FUNC(kim1_state::xram_postload), this));
+
+	m_vram_serial = 0;
+	std::fill(std::begin(m_vram_row_serial), std::end(m_vram_row_serial), 0);
+	m_text_serial = 0;
+	m_text_valid = false;
+	m_thumb_serial = 0;
+	m_thumb_valid = false;
+	m_monitor_hle = false;
+	m_hle_active = false;
+	m_cmos = m_maincpu->type() == M65C02;
+	m_hostcall_mapped = false;
+	m_hostfs_mapped = false;
+	m_snap_mapped = false;
+	m_blkdev_mapped = false;
+	m_xram_mapped = true;
+	m_dma_mapped = false;
+	m_apu_mapped = false;
+	m_perf_mapped = false;
+	m_copro_mapped = false;
+	m_snap_status = 0;
+	m_snap_index = 0;
+	m_first_reset_done = false;
+	m_warmboot_timer = machine().scheduler().timer_alloc(timer_expired_delegate(FUNC(kim1_state::warmboot_cycles), this));
+	m_warmboot_pending = 0;
+	m_diff_watching = false;
+	m_diff_timer = machine().scheduler().timer_alloc(timer_expired_delegate(FUNC(kim1_state::diff_step), this));
+	m_pc_hook_pc = ~0;
+	m_pc_hook_ptr = nullptr;
+	m_wait_kind = WAIT_NONE;
+	std::fill(std::begin(m_led_segments), std::end(m_led_segments), 0);
+	m_checkpoint_timer = machine().scheduler().timer_alloc(timer_expired_delegate(FUNC(kim1_state::checkpoint_tick), this));
+	m_checkpoint_slot = 0;
+	m_checkpoint_pending = 0;
+	m_checkpoint_active = false;
+	m_checkpoint_old_handler = SIG_DFL;
+	m_link_timer = machine().scheduler().timer_alloc(timer_expired_delegate(FUNC(kim1_state::kim1_link_sync), this));
+	m_link_broken = false;
+	m_control_timer = machine().scheduler().timer_alloc(timer_expired_delegate(FUNC(kim1_state::control_service), this));
+	m_control_keys = 0;
+	machine().add_notify(MACHINE_NOTIFY_EXIT, machine_notify_delegate(FUNC(kim1_state::checkpoint_exit), this));
+	machine().add_notify(MACHINE_NOTIFY_EXIT, machine_notify_delegate(FUNC(kim1_state::warmboot_exit), this));
+
+	std::fill(std::begin(m_kvos_hook), std::end(m_kvos_hook), 0);
+	m_kvos_mode = 0;
+	m_kvos_shadow = false;
+	m_kvos_pending.active = false;
+	m_kvos_checks = 0;
+	m_kvos_mismatches = 0;
+	machine().add_notify(MACHINE_NOTIFY_EXIT, machine_notify_delegate(FUNC(kim1_state::kvos_exit), this));
+	kvos_register(0xf88a, "plot", [this] (kvos_regs &regs) { return kvos_plot(regs); });
+	kvos_register(0xf956, "clear", [this] (kvos_regs &regs) { return kvos_clear_window(regs); });
+
+	machine().save().register_postload(save_prepost_delegate(FUNC(kim1_state::vram_postload), this));
+	machine().save().register_presave(save_prepost_delegate(FUNC(kim1_state::backing_presave), this));
+	machine().save().register_postload(save_prepost_delegate(FUNC(kim1_state::backing_postload), this));
+	machine().add_notify(MACHINE_NOTIFY_FRAME, machine_notify_delegate(FUNC(kim1_state::shm_frame), this));
+	machine().add_notify(MACHINE_NOTIFY_EXIT, machine_notify_delegate(FUNC(kim1_state::nvram_exit), this));
 }
 
 void kim1_state::machine_reset()
@@ -267,6 +740,384 @@ void kim1_state::machine_reset()
 
 	m_311_output = 0;
 	m_cassette_high_count = 0;
+
+	m_xram_latch = 0;
+	m_xram_bank->set_entry(0);
+
+	m_copro_control = 0;
+	m_copro_status = 0;
+	m_copro->set_input_line(INPUT_LINE_RESET, ASSERT_LINE);
+	m_copro->set_input_line(M6502_IRQ_LINE, CLEAR_LINE);
+
+	/* a differential watch does not outlive a reset */
+	if (m_diff_watching)
+		diff_watch(false);
+
+	/* hook or unhook the monitor display/keypad routines */
+	bool hle = (m_config->read() & 0x04) && !m_cmos;
+	if (hle != m_monitor_hle)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (hle)
+			space.install_read_handler(0x1efe, 0x1f90, read8_delegate(FUNC(kim1_state::monitor_hle_r), this));
+		else
+			space.install_rom(0x1efe, 0x1f90, &m_rom[0x1efe]);
+		m_monitor_hle = hle;
+	}
+
+	/* same for the KVOS ROM when native routines are wanted */
+	int kvos_mode = m_cmos ? 0 : (m_config->read() & 0x18);
+	if ((kvos_mode != 0) != (m_kvos_mode != 0))
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (kvos_mode)
+			space.install_read_handler(0xf000, 0xffff, read8_delegate(FUNC(kim1_state::kvos_hook_r), this));
+		else
+			space.install_rom(0xf000, 0xffff, &m_rom[0xf000]);
+	}
+	m_kvos_mode = kvos_mode;
+	m_kvos_pending.active = false;
+
+	/* opt-in expansion I/O */
+	bool hostcall = m_config->read() & 0x20;
+	if (hostcall != m_hostcall_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (hostcall)
+			space.install_readwrite_handler(0xe000, 0xe00f, read8_delegate(FUNC(kim1_hostcall_device::read), m_hostcall.target()), write8_delegate(FUNC(kim1_hostcall_device::write), m_hostcall.target()));
+		else
+			space.unmap_readwrite(0xe000, 0xe00f);
+		m_hostcall_mapped = hostcall;
+	}
+
+	bool hostfs = m_config->read() & 0x100;
+	if (hostfs != m_hostfs_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (hostfs)
+			space.install_readwrite_handler(0xe020, 0xe02f, read8_delegate(FUNC(kim1_hostfs_device::read), m_hostfs.target()), write8_delegate(FUNC(kim1_hostfs_device::write), m_hostfs.target()));
+		else
+			space.unmap_readwrite(0xe020, 0xe02f);
+		m_hostfs_mapped = hostfs;
+	}
+
+	bool blkdev = m_config->read() & 0x20000;
+	if (blkdev != m_blkdev_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (blkdev)
+			space.install_readwrite_handler(0xe010, 0xe01f, read8_delegate(FUNC(kim1_blkdev_device::read), m_blkdev.target()), write8_delegate(FUNC(kim1_blkdev_device::write), m_blkdev.target()));
+		else
+			space.unmap_readwrite(0xe010, 0xe01f);
+		m_blkdev_mapped = blkdev;
+	}
+
+	bool xram = m_config->read() & 0x40000;
+	if (xram != m_xram_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (xram)
+		{
+			space.install_readwrite_bank(0x8000, 0x9fff, "xram");
+			space.install_readwrite_handler(0xe030, 0xe030, read8_delegate(FUNC(kim1_state::xram_bank_r), this), write8_delegate(FUNC(kim1_state::xram_bank_w), this));
+		}
+		else
+		{
+			/* the card is in the map until the first reset, so its bank exists */
+			space.unmap_readwrite(0x8000, 0x9fff);
+			space.unmap_readwrite(0xe030, 0xe030);
+		}
+		m_xram_mapped = xram;
+	}
+
+	bool dma = m_config->read() & 0x80000;
+	if (dma != m_dma_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (dma)
+			space.install_readwrite_handler(0xe040, 0xe047, read8_delegate(FUNC(kim1_dma_device::read), m_dma.target()), write8_delegate(FUNC(kim1_dma_device::write), m_dma.target()));
+		else
+			space.unmap_readwrite(0xe040, 0xe047);
+		m_dma_mapped = dma;
+	}
+
+	bool apu = m_config->read() & 0x100000;
+	if (apu != m_apu_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (apu)
+			space.install_readwrite_handler(0xe050, 0xe051, read8_delegate(FUNC(kim1_apu_device::read), m_apu.target()), write8_delegate(FUNC(kim1_apu_device::write), m_apu.target()));
+		else
+			space.unmap_readwrite(0xe050, 0xe051);
+		m_apu_mapped = apu;
+	}
+
+	bool perf = m_config->read() & 0x200000;
+	if (perf != m_perf_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (perf)
+			space.install_readwrite_handler(0xe060, 0xe07f, read8_delegate(FUNC(kim1_perf_device::read), m_perf.target()), write8_delegate(FUNC(kim1_perf_device::write), m_perf.target()));
+		else
+			space.unmap_readwrite(0xe060, 0xe07f);
+		m_perf_mapped = perf;
+	}
+
+	bool copro = m_config->read() & 0x400000;
+	if (copro != m_copro_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (copro)
+		{
+			space.install_ram(0xe100, 0xe1ff, m_mailbox);
+			space.install_readwrite_handler(0xe200, 0xe200, read8_delegate(FUNC(kim1_state::copro_status_r), this), write8_delegate(FUNC(kim1_state::copro_control_w), this));
+		}
+		else
+			space.unmap_readwrite(0xe100, 0xe200);
+		m_copro_mapped = copro;
+	}
+
+	bool snap = m_config->read() & 0x4000;
+	if (snap != m_snap_mapped)
+	{
+		address_space &space = m_maincpu->space(AS_PROGRAM);
+		if (snap)
+			space.install_readwrite_handler(0xe080, 0xe082, read8_delegate(FUNC(kim1_state::snap_r), this), write8_delegate(FUNC(kim1_state::snap_w), this));
+		else
+			space.unmap_readwrite(0xe080, 0xe082);
+		m_snap_mapped = snap;
+	}
+	m_snap_status = 0;
+
+	m_apu->set_instant(m_config->read() & 0x200);
+
+	/* differential check against another process; this stays until exit */
+	int diff_side = (m_config->read() >> 12) & 0x03;
+	if (diff_side != 0 && diff_side != 3 && !m_diff.is_open())
+	{
+		const char *name = getenv("KIM1_DIFF");
+		if (name == nullptr || *name == 0)
+			name = "kim1.diff";
+
+		m_diff_side = diff_side - 1;
+		m_diff_count = 0;
+		m_diff_full = true;
+		if (m_diff.open(name, m_diff_side))
+			osd_printf_info("KIM-1 differential check /%s, %s side\n", name, m_diff_side ? "fast" : "reference");
+		else
+			osd_printf_error("Could not attach to differential check /%s\n", name);
+	}
+
+	/* serial link to another process; this stays until exit, or until
+	   the peer stalls */
+	int link_side = (m_config->read() >> 10) & 0x03;
+	if (link_side != 0 && !m_link.is_open() && !m_link_broken)
+	{
+		const char *name = getenv("KIM1_LINK");
+		if (name == nullptr || *name == 0)
+			name = "kim1.link";
+
+		m_link_tx = 1;
+		m_link_rx = 1;
+		if (m_link.open(name, link_side - 1))
+		{
+			m_link_timer->adjust(attotime::from_usec(LINK_PERIOD), 0, attotime::from_usec(LINK_PERIOD));
+			osd_printf_info("KIM-1 serial link /%s, side %c\n", name, 'A' + link_side - 1);
+		}
+		else
+			osd_printf_error("Could not attach to serial link /%s\n", name);
+	}
+
+	/* first reset only: resume from a checkpoint, or else restore the
+	   warm-boot state or arm the boot point */
+	if (!m_first_reset_done)
+	{
+		/* driven by a client through a control channel; the machine
+		   stops before its first instruction */
+		const char *control = getenv("KIM1_CTL");
+		if (control != nullptr && *control != 0)
+		{
+			if (m_control.open(control))
+				m_control_timer->adjust(attotime::zero);
+			else
+				osd_printf_error("Could not attach to control channel /%s\n", control);
+		}
+
+		bool resumed = (m_config->read() & 0x10000) && checkpoint_start();
+		if (!resumed && (m_config->read() & 0x8000))
+			warmboot_start();
+	}
+	m_first_reset_done = true;
+
+	/* file-backed RAM; this stays until exit */
+	if ((m_config->read() & 0x80) && !m_nvram.is_open())
+		nvram_open();
+
+	/* move RAM and video into shared memory; this stays until exit */
+	if ((m_config->read() & 0x40) && !m_shm.is_open())
+	{
+		uint32_t ram_size = m_nvram.is_open() ? 0 : m_ram.bytes();
+
+		if (m_shm.open("kim1", 0x2000, ram_size, 0x4000, m_videoram.bytes()))
+		{
+			if (ram_size != 0)
+			{
+				memcpy(m_shm.ram(), m_ram, ram_size);
+				m_maincpu->space(AS_PROGRAM).install_ram(0x2000, 0x3fff, m_shm.ram());
+				m_ram.set_target(m_shm.ram(), ram_size);
+			}
+			memcpy(m_shm.vram(), m_videoram, m_videoram.bytes());
+			m_videoram.set_target(m_shm.vram(), m_videoram.bytes());
+			m_shm.frame_begin();
+			osd_printf_info("KIM-1 memory shared as %s\n", m_shm.name().c_str());
+		}
+		else
+			logerror("unable to create shared memory\n");
+	}
+}
+
+
+
+/*************************************
+ *
+ *  Monitor HLE
+ *
+ *************************************/
+
+/* cycles taken by the 6530-002 code, from the instruction timings of the
+   listing; each includes the final RTS */
+#define SCANDS_CYCLES       (10 + 3 * 1379 - 1 + 13)    /* 1F1F up to JMP AK */
+#define SCAND_CYCLES        10                          /* 1F19 before 1F1F */
+#define AK_CYCLES           72
+
+READ8_MEMBER(kim1_state::monitor_hle_r)
+{
+	offs_t pc = 0x1efe + offset;
+	int cycles = 0;
+
+	/* anything other than an opcode fetch at an entry point reads the ROM */
+	if (!m_maincpu->get_sync() || m_hle_active)
+		return m_rom[pc];
+
+	m_hle_active = true;
+	switch (pc)
+	{
+	case 0x1f19:    /* SCAND: fetch the byte at (FA) into F9, then SCANDS */
+		space.write_byte(0xf9, space.read_byte(space.read_byte(0xfa) | (space.read_byte(0xfb) << 8)));
+		cycles += SCAND_CYCLES;
+		/* fall through */
+	case 0x1f1f:    /* SCANDS: display FB FA F9, then AK */
+		monitor_hle_scands(space);
+		cycles += SCANDS_CYCLES;
+		/* fall through */
+	case 0x1efe:    /* AK */
+		monitor_hle_ak(space, cycles);
+		break;
+
+	case 0x1f6a:    /* GETKEY */
+		monitor_hle_getkey(space, cycles);
+		break;
+
+	default:
+		m_hle_active = false;
+		return m_rom[pc];
+	}
+	m_hle_active = false;
+
+	return 0x60;    /* RTS back to the caller */
+}
+
+
+void kim1_state::monitor_hle_scands(address_space &space)
+{
+	/* six digits, high nibble first, from FB down to F9 */
+	for (int i = 0; i < 3; i++)
+	{
+		uint8_t data = space.read_byte(0xfb - i);
+		led_set(i * 2 + 0, m_rom[0x1fe7 + (data >> 4)]);
+		led_set(i * 2 + 1, m_rom[0x1fe7 + (data & 0x0f)]);
+	}
+
+	/* leave port A as inputs, as the ROM does before falling into AK */
+	space.write_byte(0x1741, 0x00);
+}
+
+
+uint8_t kim1_state::keypad_row(int row)
+{
+	/* keys held through the control channel read as pressed */
+	uint8_t held = (m_control_keys >> (row * 7)) & 0x7f;
+
+	switch (row)
+	{
+	case 0: return m_row0->read() & ~held;
+	case 1: return m_row1->read() & ~held;
+	case 2: return m_row2->read() & ~held;
+	}
+	return 0xff;
+}
+
+
+void kim1_state::monitor_hle_ak(address_space &space, int cycles)
+{
+	uint8_t keys = keypad_row(0) & keypad_row(1) & keypad_row(2);
+
+	/* the ROM leaves 7 on port B, deselecting every row and digit */
+	space.write_byte(0x1742, 0x07);
+
+	uint8_t a = ~(keys | 0x80);
+	monitor_hle_return(a, 0x07, 0x07, a, cycles + AK_CYCLES);
+}
+
+
+void kim1_state::monitor_hle_getkey(address_space &space, int cycles)
+{
+	cycles += 2;    /* LDX #$21 */
+
+	for (int row = 0; row < 3; row++)
+	{
+		uint8_t keys = ~(keypad_row(row) | 0x80);
+
+		if (keys == 0)
+		{
+			cycles += 49;
+			continue;
+		}
+
+		/* the first key from bit 6 down wins; rows are seven keys apart */
+		int col = 0;
+		while (!BIT(keys, 6 - col))
+			col++;
+
+		cycles += 45 + 2 + 9 * (col + 1) + 5 + 13 + 9 * row + 4 + 6;
+		/* the ROM ends on the DEX that counts X down to 0, so Z is set */
+		space.write_byte(0x1742, 0x07);
+		monitor_hle_return(row * 7 + col, 0x00, col, 0x00, cycles);
+		return;
+	}
+
+	space.write_byte(0x1742, 0x07);
+	monitor_hle_return(0x15, 0x27, 0x07, 0x15, cycles - 1 + 8);
+}
+
+
+void kim1_state::monitor_hle_return(uint8_t a, uint8_t x, uint8_t y, uint8_t nz, int cycles)
+{
+	/* N and Z come from nz, the last result the ROM code set them from */
+	uint8_t p = m_maincpu->state_int(M6502_P) & ~0x82;
+
+	if (nz == 0)
+		p |= 0x02;
+	if (nz & 0x80)
+		p |= 0x80;
+
+	m_maincpu->set_state_int(M6502_A, a);
+	m_maincpu->set_state_int(M6502_X, x);
+	m_maincpu->set_state_int(M6502_Y, y);
+	m_maincpu->set_state_int(M6502_P, p);
+
+	/* the RTS we hand back takes its own 6 cycles */
+	m_maincpu->adjust_icount(-(cycles - 6));
 }
 
 /*************************************
@@ -275,6 +1126,118 @@ void kim1_state::machine_reset()
  *
  *************************************/
 
+int kim1_state::scanline_to_vram_row(int scanline) const
+{
+	return m_flipscreen ? scanline : (VRAM_ROWS - 1) - scanline;
+}
+
+void kim1_state::mark_vram_dirty(offs_t offset)
+{
+	if (m_wait_kind == WAIT_VRAM && offset >= m_wait_start && offset <= m_wait_end)
+		wait_fired();
+	if (offset < VRAM_PITCH * VRAM_ROWS)
+		m_vram_row_serial[offset / VRAM_PITCH] = ++m_vram_serial;
+}
+
+void kim1_state::mark_vram_dirty_range(offs_t start, offs_t end)
+{
+	if (m_wait_kind == WAIT_VRAM && start <= m_wait_end && end >= m_wait_start)
+		wait_fired();
+	if (start >= VRAM_PITCH * VRAM_ROWS)
+		return;
+	end = std::min<offs_t>(end, VRAM_PITCH * VRAM_ROWS - 1);
+
+	m_vram_serial++;
+	for (int row = start / VRAM_PITCH; row <= end / VRAM_PITCH; row++)
+		m_vram_row_serial[row] = m_vram_serial;
+}
+
+bool kim1_state::vram_row_dirty(int row, uint32_t since) const
+{
+	return int32_t(m_vram_row_serial[row] - since) > 0;
+}
+
+void kim1_state::vram_postload()
+{
+	/* a restored state can differ anywhere, so dirty every row */
+	m_vram_serial++;
+	std::fill(std::begin(m_vram_row_serial), std::end(m_vram_row_serial), m_vram_serial);
+}
+
+void kim1_state::backing_presave()
+{
+	/* save states are taken from the original memory, wherever the
+	   expansion RAM and video have been moved to */
+	if (m_ram.target() != memshare("ram")->ptr())
+		memcpy(memshare("ram")->ptr(), m_ram, m_ram.bytes());
+	if (m_videoram.target() != memshare("videoram")->ptr())
+		memcpy(memshare("videoram")->ptr(), m_videoram, m_videoram.bytes());
+	if (m_colorram.target() != memshare("colorram")->ptr())
+		memcpy(memshare("colorram")->ptr(), m_colorram, m_colorram.bytes());
+}
+
+void kim1_state::backing_postload()
+{
+	if (m_ram.target() != memshare("ram")->ptr())
+		memcpy(m_ram, memshare("ram")->ptr(), m_ram.bytes());
+	if (m_videoram.target() != memshare("videoram")->ptr())
+		memcpy(m_videoram, memshare("videoram")->ptr(), m_videoram.bytes());
+	if (m_colorram.target() != memshare("colorram")->ptr())
+		memcpy(m_colorram, memshare("colorram")->ptr(), m_colorram.bytes());
+}
+
+void kim1_state::nvram_open()
+{
+	/* let the core find or create the file so the directory exists */
+	std::string name = string_format("%s" PATH_SEPARATOR "ram2000.map", machine().basename());
+	emu_file existing(machine().options().nvram_directory(), OPEN_FLAG_READ | OPEN_FLAG_WRITE);
+	std::string path;
+
+	if (existing.open(name.c_str()) == osd_file::error::NONE)
+		path = existing.fullpath();
+	else
+	{
+		emu_file created(machine().options().nvram_directory(), OPEN_FLAG_READ | OPEN_FLAG_WRITE | OPEN_FLAG_CREATE | OPEN_FLAG_CREATE_PATHS);
+		if (created.open(name.c_str()) == osd_file::error::NONE)
+			path = created.fullpath();
+	}
+	existing.close();
+
+	kim1_mapped_nvram::state state;
+	if (path.empty() || !m_nvram.open(path.c_str(), m_ram.bytes(), state))
+	{
+		logerror("unable to map %s\n", name.c_str());
+		return;
+	}
+
+	if (state == kim1_mapped_nvram::state::NEW)
+		memcpy(m_nvram.data(), m_ram, m_ram.bytes());
+	else if (state == kim1_mapped_nvram::state::UNCLEAN)
+		osd_printf_warning("%s was not closed cleanly; its contents may be incomplete\n", path.c_str());
+
+	m_maincpu->space(AS_PROGRAM).install_ram(0x2000, 0x3fff, m_nvram.data());
+	m_ram.set_target(m_nvram.data(), m_ram.bytes());
+}
+
+void kim1_state::nvram_exit()
+{
+	if (!m_nvram.is_open())
+		return;
+
+	/* hand the RAM back before the mapping goes away */
+	memcpy(m_arena_ram, m_nvram.data(), m_ram.bytes());
+	m_maincpu->space(AS_PROGRAM).install_ram(0x2000, 0x3fff, m_arena_ram);
+	m_ram.set_target(m_arena_ram, m_ram.bytes());
+	m_nvram.close();
+}
+
+void kim1_state::shm_frame()
+{
+	/* emulation of the next frame starts */
+	if (m_shm.is_open())
+		m_shm.frame_begin();
+}
+
 bool kim1_state::get_madsel()
 {
 	/* the MADSEL signal disables standard address decoding and routes
@@ -390,58 +1353,1425 @@ uint8_t kim1_state::read_vram(address_space &space, offs_t address)
 
 /*************************************
  *
- *  Video update
+ *  KVOS native routines
  *
  *************************************/
 
-//uint32_t kim1_state::screen_update_kim1(screen_device &screen, bitmap_ind16 &bitmap, const rectangle &cliprect)
-uint32_t kim1_state::screen_update_kim1(screen_device &screen, bitmap_rgb32 &bitmap, const rectangle &cliprect)
+#define KVOS_VRAM_BASE      0xa000
+
+void kim1_state::kvos_register(offs_t entry, const char *name, kvos_native_func func)
 {
-	uint8_t *videoram = m_videoram;
-	int x, y;
+	assert(entry >= 0xf000 && entry <= 0xffff);
 
-	/* draw the bitmap to the screen, looping over Y */
-	for (y = cliprect.min_y; y <= cliprect.max_y; y++)
+	m_kvos_natives.push_back(kvos_native{ entry, name, std::move(func) });
+	m_kvos_hook[entry & 0xfff] = m_kvos_natives.size();
+}
+
+
+uint8_t kim1_state::kvos_read(offs_t address)
+{
+	if (m_kvos_shadow)
 	{
-		// uint16_t *dst = &bitmap.pix32(y);
-		uint32_t *dst = &bitmap.pix32(y);
-		int effy = m_flipscreen ? (y & 0xff) : (199 - y) & 0xff;
-		uint8_t *src = &videoram[effy * 40];
-		// uint8_t *src3 = nullptr;
+		auto written = m_kvos_writes.find(address);
+		if (written != m_kvos_writes.end())
+			return written->second;
+	}
 
-		/* compute the base of the 3rd pixel row */
-		//if (effy >= 224)
-		//	src3 = &videoram[get_bit3_addr(effy << 8)];
+	if (address >= KVOS_VRAM_BASE && address < KVOS_VRAM_BASE + m_videoram.bytes())
+		return m_videoram[address - KVOS_VRAM_BASE];
 
-		/* loop over X */
-		for (x = cliprect.min_x; x <= cliprect.max_x; x += 8)
-		{
-			uint8_t pix = src[x / 8];
-			//uint8_t pix = src[x / 4] >> (x & 3);
-			//pix = ((pix >> 2) & 4) | ((pix << 1) & 2);
+	return m_maincpu->space(AS_PROGRAM).read_byte(address);
+}
 
-			/* if we're in the lower region, get the 3rd bit */
-			//if (src3 != nullptr)
-			//	pix |= (src3[(x / 8) * 2] >> (x & 7)) & 1;
 
-			//dst[x] = pix;
-			
+void kim1_state::kvos_write(offs_t address, uint8_t data)
+{
+	if (m_kvos_shadow)
+		m_kvos_writes[address] = data;
+	else if (address >= KVOS_VRAM_BASE && address < KVOS_VRAM_BASE + m_videoram.bytes())
+	{
+		m_videoram[address - KVOS_VRAM_BASE] = data;
+		mark_vram_dirty(address - KVOS_VRAM_BASE);
+	}
+	else
+		m_maincpu->space(AS_PROGRAM).write_byte(address, data);
+}
+
+
+void kim1_state::kvos_fill(offs_t address, int count, uint8_t data)
+{
+	/* straight into the frame buffer when we can */
+	if (!m_kvos_shadow && address >= KVOS_VRAM_BASE && address + count <= KVOS_VRAM_BASE + m_videoram.bytes())
+	{
+		memset(&m_videoram[address - KVOS_VRAM_BASE], data, count);
+		mark_vram_dirty_range(address - KVOS_VRAM_BASE, address - KVOS_VRAM_BASE + count - 1);
+		return;
+	}
+
+	while (count--)
+		kvos_write(address++, data);
+}
+
+
+READ8_MEMBER(kim1_state::kvos_hook_r)
+{
+	offs_t pc = 0xf000 + offset;
+
+	if (!m_maincpu->get_sync() || m_hle_active)
+		return m_rom[pc];
+
+	uint8_t sp = m_maincpu->state_int(M6502_S);
+
+	/* a verified call is returning */
+	if (m_kvos_pending.active && pc == m_kvos_pending.ret_pc && sp == m_kvos_pending.ret_sp)
+		kvos_verify();
+
+	if (m_kvos_hook[offset] == 0)
+		return m_rom[pc];
+
+	const kvos_native &native = m_kvos_natives[m_kvos_hook[offset] - 1];
+	kvos_regs regs;
+	regs.a = m_maincpu->state_int(M6502_A);
+	regs.x = m_maincpu->state_int(M6502_X);
+	regs.y = m_maincpu->state_int(M6502_Y);
+	regs.p = m_maincpu->state_int(M6502_P);
+
+	if (m_kvos_mode == 0x18)
+	{
+		/* nested calls are left to the outer check */
+		if (m_kvos_pending.active)
+			return m_rom[pc];
+
+		/* run the native code on the side and let the 6502 code run */
+		m_hle_active = m_kvos_shadow = true;
+		m_kvos_writes.clear();
+		native.func(regs);
+		m_hle_active = m_kvos_shadow = false;
+
+		offs_t ret = space.read_byte(0x100 | uint8_t(sp + 1)) | (space.read_byte(0x100 | uint8_t(sp + 2)) << 8);
+		m_kvos_pending.active = true;
+		m_kvos_pending.native = &native;
+		m_kvos_pending.ret_pc = (ret + 1) & 0xffff;
+		m_kvos_pending.ret_sp = sp + 2;
+		m_kvos_pending.regs = regs;
+		m_kvos_pending.writes.swap(m_kvos_writes);
+		return m_rom[pc];
+	}
+
+	m_hle_active = true;
+	int cycles = native.func(regs);
+	m_hle_active = false;
+
+	m_maincpu->set_state_int(M6502_A, regs.a);
+	m_maincpu->set_state_int(M6502_X, regs.x);
+	m_maincpu->set_state_int(M6502_Y, regs.y);
+	m_maincpu->set_state_int(M6502_P, regs.p);
+
+	/* the RTS we hand back takes its own 6 cycles */
+	if (m_kvos_mode == 0x08)
+		m_maincpu->adjust_icount(-(cycles - 6));
+
+	return 0x60;
+}
+
+
+void kim1_state::kvos_verify()
+{
+	const kvos_regs &expected = m_kvos_pending.regs;
+	uint8_t a = m_maincpu->state_int(M6502_A);
+	uint8_t x = m_maincpu->state_int(M6502_X);
+	uint8_t y = m_maincpu->state_int(M6502_Y);
+	uint8_t p = m_maincpu->state_int(M6502_P);
+	bool match = true;
+
+	m_kvos_pending.active = false;
+	m_kvos_checks++;
+	m_hle_active = true;
+
+	/* compare N, V, Z and C only */
+	if (a != expected.a || x != expected.x || y != expected.y || ((p ^ expected.p) & 0xc3) != 0)
+	{
+		logerror("KVOS %s: registers A=%02X X=%02X Y=%02X P=%02X, native A=%02X X=%02X Y=%02X P=%02X\n",
+				m_kvos_pending.native->name, a, x, y, p, expected.a, expected.x, expected.y, expected.p);
+		match = false;
+	}
+
+	for (auto &written : m_kvos_pending.writes)
+	{
+		uint8_t data = kvos_read(written.first);
+		if (data != written.second)
+		{
+			logerror("KVOS %s: %04X=%02X, native wrote %02X\n", m_kvos_pending.native->name, written.first, data, written.second);
+			match = false;
+		}
+	}
+
+	m_hle_active = false;
+	if (!match)
+		m_kvos_mismatches++;
+}
+
+
+void kim1_state::kvos_exit()
+{
+	/* the details went to the error log as they happened */
+	if (m_kvos_checks != 0)
+		osd_printf_info("KVOS verify: %u of %u returns mismatched\n", kvos_mismatches(), m_kvos_checks);
+}
+
+
+/* F88A: set or clear one pixel; (FB) points at the byte, FD is the bit
+   number from the left, bit 6 of FA selects set */
+int kim1_state::kvos_plot(kvos_regs &regs)
+{
+	uint8_t mask = kvos_read(0xf8a2 + kvos_read(0xfd));
+	offs_t address = kvos_read(0xfb) | (kvos_read(0xfc) << 8);
+	uint8_t mode = kvos_read(0xfa);
+	int cycles;
+
+	/* V comes from the BIT test, N and Z from the result */
+	regs.p = (regs.p & ~0xc2) | (mode & 0x40);
+
+	if (BIT(mode, 6))
+	{
+		regs.a = mask | kvos_read(address);
+		regs.p &= ~0x01;
+		cycles = 33;
+	}
+	else
+	{
+		regs.a = ~mask & kvos_read(address);
+		cycles = 34;
+	}
+	kvos_write(address, regs.a);
+
+	regs.y = 0;
+	regs.p |= (regs.a & 0x80) | (regs.a ? 0 : 0x02);
+	return cycles;
+}
+
+
+/* F956: clear from A000 up to (but not including) the address in 1632/1633,
+   a page at a time from the top down */
+int kim1_state::kvos_clear_window(kvos_regs &regs)
+{
+	uint8_t page = kvos_read(0x1633);
+	uint8_t count = kvos_read(0x1632);
+	int cycles = 13;
+
+	kvos_write(0xfb, 0x00);
+	do
+	{
+		kvos_write(0xfc, page);
+		kvos_fill(page << 8, count ? count : 256, 0x00);
+		cycles += 11 * (count ? count : 256) + 9;
+		count = 0;
+		page--;
+	} while (page >= 0xa0);
+
+	regs.a = 0x00;
+	regs.x = page;
+	regs.y = 0x00;
+
+	/* flags from the final CPX #$A0 */
+	uint8_t diff = page - 0xa0;
+	regs.p = (regs.p & ~0x83) | (diff & 0x80);
+	return cycles - 1 + 6;
+}
+
+
+
+/*************************************
+ *
+ *  Video update
+ *
+ *************************************/
+
+//uint32_t kim1_state::screen_update_kim1(screen_device &screen, bitmap_ind16 &bitmap, const rectangle &cliprect)
+uint32_t kim1_state::screen_update_kim1(screen_device &screen, bitmap_rgb32 &bitmap, const rectangle &cliprect)
+{
+	uint8_t *videoram = m_videoram;
+	int x, y;
+
+	if (m_config->read() & 0x02)
+	{
+		/* colour mode: expand each byte through its cell's attribute table */
+		for (y = cliprect.min_y; y <= cliprect.max_y; y++)
+		{
+			uint32_t *dst = &bitmap.pix32(y);
+			int effy = scanline_to_vram_row(y);
+			const uint8_t *src = &videoram[effy * VRAM_PITCH];
+			const uint8_t *attr = &m_colorram[(effy / 8) * TEXT_COLS];
+
+			for (x = cliprect.min_x; x <= cliprect.max_x; x += 8)
+				memcpy(&dst[x], &attr_expansion(attr[x / 8])[src[x / 8] * 8], 8 * sizeof(uint32_t));
+		}
+		return 0;
+	}
+
+	/* draw the bitmap to the screen, looping over Y */
+	for (y = cliprect.min_y; y <= cliprect.max_y; y++)
+	{
+		// uint16_t *dst = &bitmap.pix32(y);
+		uint32_t *dst = &bitmap.pix32(y);
+		int effy = m_flipscreen ? (y & 0xff) : (199 - y) & 0xff;
+		uint8_t *src = &videoram[effy * 40];
+		// uint8_t *src3 = nullptr;
+
+		/* compute the base of the 3rd pixel row */
+		//if (effy >= 224)
+		//	src3 = &videoram[get_bit3_addr(effy << 8)];
+
+		/* loop over X */
+		for (x = cliprect.min_x; x <= cliprect.max_x; x += 8)
+		{
+			uint8_t pix = src[x / 8];
+			//uint8_t pix = src[x / 4] >> (x & 3);
+			//pix = ((pix >> 2) & 4) | ((pix << 1) & 2);
+
+			/* if we're in the lower region, get the 3rd bit */
+			//if (src3 != nullptr)
+			//	pix |= (src3[(x / 8) * 2] >> (x & 7)) & 1;
+
+			//dst[x] = pix;
+			
 			//for (int bitpos = 0; bitpos < 8; bitpos++)
 			//{
 
-			//(pix & ( 2 << ( 7 - bitpos) ) ) ? dst[x + bitpos] = 0xffffff : dst[x + bitpos] = 0x0; 
-			//}
-			(pix & 128) ? dst[x] = 0xffffff : dst[x] = 0x0;
-			(pix & 64) ? dst[x+1] = 0xffffff : dst[x+1] = 0x0;
-			(pix & 32) ? dst[x+2] = 0xffffff : dst[x+2] = 0x0;
-			(pix & 16) ? dst[x+3] = 0xffffff : dst[x+3] = 0x0;
-			(pix & 8) ? dst[x+4] = 0xffffff : dst[x+4] = 0x0;
-			(pix & 4) ? dst[x+5] = 0xffffff : dst[x+5] = 0x0;
-			(pix & 2) ? dst[x+6] = 0xffffff : dst[x+6] = 0x0;
-			(pix & 1) ? dst[x+7] = 0xffffff : dst[x+7] = 0x0;
+			//(pix & ( 2 << ( 7 - bitpos) ) ) ? dst[x + bitpos] = 0xffffff : dst[x + bitpos] = 0x0; 
+			//}
+			(pix & 128) ? dst[x] = 0xffffff : dst[x] = 0x0;
+			(pix & 64) ? dst[x+1] = 0xffffff : dst[x+1] = 0x0;
+			(pix & 32) ? dst[x+2] = 0xffffff : dst[x+2] = 0x0;
+			(pix & 16) ? dst[x+3] = 0xffffff : dst[x+3] = 0x0;
+			(pix & 8) ? dst[x+4] = 0xffffff : dst[x+4] = 0x0;
+			(pix & 4) ? dst[x+5] = 0xffffff : dst[x+5] = 0x0;
+			(pix & 2) ? dst[x+6] = 0xffffff : dst[x+6] = 0x0;
+			(pix & 1) ? dst[x+7] = 0xffffff : dst[x+7] = 0x0;
+		}
+	}
+	return 0;
+}
+
+
+const uint32_t *kim1_state::attr_expansion(uint8_t attr)
+{
+	int fg = ~attr & 7;
+	int bg = (attr >> 4) & 7;
+	std::unique_ptr<uint32_t[]> &table = m_attr_cache[(bg << 3) | fg];
+
+	if (!table)
+	{
+		table = std::make_unique<uint32_t[]>(256 * 8);
+		for (int pix = 0; pix < 256; pix++)
+			for (int bit = 0; bit < 8; bit++)
+				table[pix * 8 + bit] = m_palette->pen(BIT(pix, 7 - bit) ? fg : bg);
+	}
+
+	return table.get();
+}
+
+
+WRITE_LINE_MEMBER(kim1_state::screen_vblank_kim1)
+{
+	if (!state)
+		return;
+
+	if (m_shm.is_open())
+		m_shm.frame_end();
+
+	/* a check still waiting for its point lets this frame go */
+	if (m_diff.is_open() && !m_diff_watching && !m_diff_timer->enabled())
+		diff_point();
+
+	if (m_warmboot_pending != 0 && --m_warmboot_pending == 0)
+		warmboot_commit();
+
+	if (m_checkpoint_active)
+	{
+		if (m_checkpoint_pending != 0 && --m_checkpoint_pending == 0)
+			checkpoint_commit();
+
+		/* asked to stop: checkpoint, then exit once it is written */
+		if (s_checkpoint_signal)
+		{
+			s_checkpoint_signal = 0;
+			m_checkpoint_timer->adjust(attotime::zero);
+			machine().schedule_exit();
+		}
+	}
+
+	if (m_config->read() & 0x01)
+		text_capture();
+
+	/* a control channel client gets the thumbnail as of this frame */
+	if (m_control.is_open())
+	{
+		kim1_control_header &ctl = m_control.header();
+
+		thumbnail_update();
+		if (ctl.thumb_serial != m_thumb_serial)
+		{
+			memcpy(ctl.thumbnail, m_thumbnail, sizeof(m_thumbnail));
+			ctl.thumb_serial = m_thumb_serial;
+		}
+	}
+}
+
+
+
+/*************************************
+ *
+ *  Text extraction
+ *
+ *************************************/
+
+uint64_t kim1_state::text_cell(int row, int col) const
+{
+	/* gather the cell's eight bytes, top scanline in the high byte */
+	uint64_t cell = 0;
+
+	for (int y = row * 8; y < row * 8 + 8; y++)
+		cell = (cell << 8) | m_videoram[scanline_to_vram_row(y) * VRAM_PITCH + col];
+
+	return cell;
+}
+
+
+uint32_t kim1_state::text_update()
+{
+	uint32_t changed = 0;
+
+	for (int row = 0; row < TEXT_ROWS; row++)
+	{
+		/* skip cell rows with no writes since the last pass */
+		if (m_text_valid)
+		{
+			bool dirty = false;
+			for (int y = row * 8; y < row * 8 + 8 && !dirty; y++)
+				dirty = vram_row_dirty(scanline_to_vram_row(y), m_text_serial);
+			if (!dirty)
+				continue;
+		}
+
+		char *dst = m_text[row];
+		bool row_changed = !m_text_valid;
+
+		for (int col = 0; col < TEXT_COLS; col++)
+		{
+			uint64_t cell = text_cell(row, col);
+			char ch = ' ';
+
+			if (cell != 0)
+			{
+				auto glyph = m_glyphs.find(cell);
+				ch = (glyph != m_glyphs.end()) ? glyph->second : '?';
+			}
+
+			if (dst[col] != ch)
+			{
+				dst[col] = ch;
+				row_changed = true;
+			}
+		}
+		dst[TEXT_COLS] = 0;
+
+		if (row_changed)
+			changed |= 1 << row;
+	}
+
+	m_text_serial = m_vram_serial;
+	m_text_valid = true;
+	return changed;
+}
+
+
+void kim1_state::text_capture()
+{
+	/* bring the text up to date, logging the rows that changed if the
+	   capture option is on */
+	uint32_t changed = text_update();
+
+	if (m_config->read() & 0x01)
+		for (int row = 0; changed != 0; row++, changed >>= 1)
+			if (changed & 1)
+				logerror("text %2d: %s\n", row, m_text[row]);
+}
+
+
+int kim1_state::text_learn(int row, const char *text)
+{
+	/* teach the glyph table from a row whose contents are known */
+	int learned = 0;
+
+	for (int col = 0; col < TEXT_COLS && text[col] != 0; col++)
+	{
+		uint64_t cell = text_cell(row, col);
+
+		if (cell != 0 && text[col] != ' ')
+		{
+			m_glyphs[cell] = text[col];
+			learned++;
+		}
+	}
+
+	/* cells matched before this glyph was known must be looked at again */
+	if (learned)
+		m_text_valid = false;
+
+	return learned;
+}
+
+
+
+/*************************************
+ *
+ *  Thumbnail
+ *
+ *************************************/
+
+const uint8_t *kim1_state::thumbnail_update()
+{
+	static_assert(int(THUMB_COLS) == int(kim1_control_header::THUMB_COLS) && int(THUMB_ROWS) == int(kim1_control_header::THUMB_ROWS), "thumbnail size");
+
+	for (int row = 0; row < THUMB_ROWS; row++)
+	{
+		const uint8_t *src[4];
+		bool dirty = !m_thumb_valid;
+
+		for (int i = 0; i < 4; i++)
+		{
+			int vrow = scanline_to_vram_row(row * 4 + i);
+			dirty |= vram_row_dirty(vrow, m_thumb_serial);
+			src[i] = &m_videoram[vrow * VRAM_PITCH];
+		}
+		if (!dirty)
+			continue;
+
+		uint8_t *dst = &m_thumbnail[row * THUMB_COLS];
+
+		for (int col = 0; col < VRAM_PITCH; col++)
+		{
+			/* one byte column covers two blocks: the high and low nibbles */
+			uint32_t quad = src[0][col] | (src[1][col] << 8) | (src[2][col] << 16) | (src[3][col] << 24);
+
+			*dst++ = (population_count_32(quad & 0xf0f0f0f0) * 255 + 8) / 16;
+			*dst++ = (population_count_32(quad & 0x0f0f0f0f) * 255 + 8) / 16;
+		}
+	}
+
+	m_thumb_serial = m_vram_serial;
+	m_thumb_valid = true;
+	return m_thumbnail;
+}
+
+
+
+/*************************************
+ *
+ *  Snapshot store
+ *
+ *************************************/
+
+// the memory in a snapshot; the RIOTs' timers and ports and the cards'
+// registers are left as they are when one is restored
+template <typename Visitor>
+void kim1_state::snapshot_visit(Visitor &&visit)
+{
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+
+	visit(reinterpret_cast<uint8_t *>(space.get_write_ptr(0x0000)), 0x400);
+	visit(reinterpret_cast<uint8_t *>(space.get_write_ptr(0x1780)), 0x40);
+	visit(reinterpret_cast<uint8_t *>(space.get_write_ptr(0x17c0)), 0x40);
+	visit(&m_ram[0], m_ram.bytes());
+	visit(&m_videoram[0], m_videoram.bytes());
+	visit(&m_colorram[0], m_colorram.bytes());
+	visit(m_xram, XRAM_BANKS * XRAM_BANK_SIZE);
+}
+
+
+void kim1_state::snapshot_take(std::vector<uint8_t> &snap, uint16_t pc)
+{
+	snap.resize(SNAP_REGS);
+	snap[0] = pc & 0xff;
+	snap[1] = pc >> 8;
+	snap[2] = m_maincpu->state_int(M6502_A);
+	snap[3] = m_maincpu->state_int(M6502_X);
+	snap[4] = m_maincpu->state_int(M6502_Y);
+	snap[5] = m_maincpu->state_int(M6502_P);
+	snap[6] = m_maincpu->state_int(M6502_S);
+	snap[7] = m_xram_latch;
+
+	snapshot_visit([&snap] (uint8_t *base, uint32_t size) { snap.insert(snap.end(), base, base + size); });
+}
+
+
+TIMER_CALLBACK_MEMBER(kim1_state::snapshot_restore)
+{
+	/* runs between timeslices, so the CPU starts afresh at the new PC */
+	const uint8_t *src = &m_snap[SNAP_REGS];
+	snapshot_visit([&src] (uint8_t *base, uint32_t size) { memcpy(base, src, size); src += size; });
+
+	m_maincpu->set_state_int(M6502_A, m_snap[2]);
+	m_maincpu->set_state_int(M6502_X, m_snap[3]);
+	m_maincpu->set_state_int(M6502_Y, m_snap[4]);
+	m_maincpu->set_state_int(M6502_P, m_snap[5]);
+	m_maincpu->set_state_int(M6502_S, m_snap[6]);
+	m_maincpu->set_state_int(M6502_PC, m_snap[0] | (m_snap[1] << 8));
+	m_xram_latch = m_snap[7] & (XRAM_BANKS - 1);
+	m_xram_bank->set_entry(m_xram_latch);
+	mark_vram_dirty_range(0, m_videoram.bytes() - 1);
+}
+
+
+bool kim1_state::snapshot_store_open(bool create)
+{
+	if (m_snap_store.is_open() && !create)
+		return true;
+
+	const char *name = getenv("KIM1_SNAP");
+	if (name == nullptr || *name == 0)
+		name = "snapshots";
+	std::string path = string_format("%s" PATH_SEPARATOR "%s.kds", machine().basename(), name);
+
+	m_snap_store.close();
+	m_snap_file = std::make_unique<emu_file>(machine().options().state_directory(), OPEN_FLAG_READ | OPEN_FLAG_WRITE | (create ? OPEN_FLAG_CREATE | OPEN_FLAG_CREATE_PATHS : 0));
+	if (m_snap_file->open(path.c_str()) != osd_file::error::NONE)
+	{
+		m_snap_file.reset();
+		return false;
+	}
+
+	if (create)
+		return true;
+
+	snapshot_take(m_snap, 0);
+	if (!m_snap_store.open(*m_snap_file, m_snap.size()))
+	{
+		logerror("%s is not a snapshot store for this machine\n", path.c_str());
+		m_snap_file.reset();
+		return false;
+	}
+	return true;
+}
+
+
+READ8_MEMBER(kim1_state::snap_r)
+{
+	switch (offset)
+	{
+	case 0: return m_snap_status;
+	case 1: return m_snap_index & 0xff;
+	case 2: return m_snap_index >> 8;
+	}
+	return 0xff;
+}
+
+
+TIMER_CALLBACK_MEMBER(kim1_state::snapshot_save)
+{
+	/* runs once the store that asked for it has finished, so the PC is
+	   that of the next instruction whatever the store's length */
+	uint16_t pc = m_maincpu->state_int(M6502_PC);
+	bool ok = false;
+
+	if (param == 1)     // new store, with this as the base
+	{
+		snapshot_take(m_snap, pc);
+		ok = snapshot_store_open(true) && m_snap_store.create(*m_snap_file, m_snap);
+		m_snap_index = 0;
+	}
+	else if (snapshot_store_open(false))     // save a snapshot, returning its index
+	{
+		snapshot_take(m_snap, pc);
+		int index = m_snap_store.append(m_snap);
+		ok = index > 0;
+		if (ok)
+			m_snap_index = index;
+	}
+	m_snap_status = ok ? 0x00 : 0x80;
+}
+
+
+WRITE8_MEMBER(kim1_state::snap_w)
+{
+	bool ok = false;
+
+	switch (offset)
+	{
+	case 0:
+		switch (data)
+		{
+		case 1:     // new store, with this as the base
+		case 2:     // save a snapshot, returning its index
+			machine().scheduler().synchronize(timer_expired_delegate(FUNC(kim1_state::snapshot_save), this), data);
+			return;
+
+		case 3:     // restore the snapshot at the index
+			if (snapshot_store_open(false))
+			{
+				snapshot_take(m_snap, 0);
+				ok = m_snap_store.fetch(m_snap_index, m_snap);
+				if (ok)
+					machine().scheduler().synchronize(timer_expired_delegate(FUNC(kim1_state::snapshot_restore), this));
+			}
+			break;
+		}
+		m_snap_status = ok ? 0x00 : 0x80;
+		break;
+
+	case 1: m_snap_index = (m_snap_index & 0xff00) | data; break;
+	case 2: m_snap_index = (m_snap_index & 0x00ff) | (data << 8); break;
+	}
+}
+
+
+
+/*************************************
+ *
+ *  PC hook
+ *
+ *************************************/
+
+void kim1_state::pc_hook(offs_t pc, int owner)
+{
+	/* the first opcode fetch from pc is caught by a read handler on the
+	   one byte, taken off again once it has fired */
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+
+	if (m_pc_hook_pc != ~0)
+		pc_unhook();
+	m_pc_hook_pc = pc;
+	m_pc_hook_owner = owner;
+	m_pc_hook_ptr = reinterpret_cast<uint8_t *>(space.get_write_ptr(pc));
+	if (m_pc_hook_ptr == nullptr)
+		m_pc_hook_ptr = &m_rom[pc];
+	space.install_read_handler(pc, pc, read8_delegate(FUNC(kim1_state::pc_hook_r), this));
+}
+
+
+void kim1_state::pc_unhook()
+{
+	/* put back whatever the hooked byte had before */
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+	offs_t pc = m_pc_hook_pc;
+
+	m_pc_hook_pc = ~0;
+	if (in_rom(pc))
+		rom_handlers_install();
+	else if (m_pc_hook_ptr == &m_rom[pc])
+		space.install_rom(pc, pc, m_pc_hook_ptr);
+	else
+		space.install_ram(pc, pc, m_pc_hook_ptr);
+}
+
+
+READ8_MEMBER(kim1_state::pc_hook_r)
+{
+	offs_t pc = m_pc_hook_pc;
+	uint8_t data;
+
+	/* pass reads on to the hooks the byte may be covered by */
+	if (m_diff_watching && in_rom(pc))
+		data = diff_watch_read(space, pc);
+	else if (m_monitor_hle && pc >= 0x1efe && pc <= 0x1f90)
+		data = monitor_hle_r(space, pc - 0x1efe);
+	else if (m_kvos_mode && pc >= 0xf000)
+		data = kvos_hook_r(space, pc - 0xf000);
+	else
+		data = *m_pc_hook_ptr;
+
+	if (m_maincpu->get_sync() && !machine().side_effect_disabled())
+	{
+		pc_unhook();
+		if (m_pc_hook_owner == PC_HOOK_WAIT)
+			wait_fired();
+		else
+			warmboot_save();
+	}
+	return data;
+}
+
+
+
+/*************************************
+ *
+ *  Warm-boot cache
+ *
+ *************************************/
+
+std::string kim1_state::state_key()
+{
+	/* what a saved state of this setup depends on: the ROM contents, the
+	   options and the warm-boot point */
+	const char *at = getenv("KIM1_WARMBOOT_AT");
+	util::sha1_t rom = util::sha1_creator::simple(&m_rom[0], memregion("maincpu")->bytes());
+
+	return string_format("%s %s %08x %s", machine().system().name, rom.as_string(), m_config->read(), at ? at : "");
+}
+
+
+void kim1_state::warmboot_start()
+{
+	std::string name = string_format("%s" PATH_SEPARATOR "warmboot", machine().basename());
+	m_warmboot_key = state_key();
+
+	/* a cached state made with the same key can be used as it is */
+	emu_file keyfile(machine().options().state_directory(), OPEN_FLAG_READ);
+	emu_file statefile(machine().options().state_directory(), OPEN_FLAG_READ);
+	if (keyfile.open((name + ".key").c_str()) == osd_file::error::NONE && statefile.open((name + ".sta").c_str()) == osd_file::error::NONE && statefile.size() != 0)
+	{
+		std::string key(keyfile.size(), '\0');
+		keyfile.read(&key[0], key.size());
+		if (key == m_warmboot_key)
+		{
+			osd_printf_info("Warm boot from %s.sta\n", name.c_str());
+			machine().schedule_load(name + ".sta");
+			return;
+		}
+	}
+
+	/* otherwise save one at the boot point: KIM1_WARMBOOT_AT is pc=XXXX
+	   for the first opcode fetch from XXXX, or a cycle count */
+	const char *at = getenv("KIM1_WARMBOOT_AT");
+	if (at != nullptr && strncmp(at, "pc=", 3) == 0)
+	{
+		pc_hook(strtoul(at + 3, nullptr, 16) & 0xffff, PC_HOOK_WARMBOOT);
+	}
+	else
+	{
+		uint64_t cycles = (at != nullptr) ? strtoull(at, nullptr, 0) : 0;
+		if (cycles == 0)
+			cycles = 1000000;
+		m_warmboot_timer->adjust(m_maincpu->cycles_to_attotime(cycles));
+	}
+}
+
+
+void kim1_state::warmboot_save()
+{
+	std::string name = string_format("%s" PATH_SEPARATOR "warmboot", machine().basename());
+
+	/* MAME writes the state at the end of this timeslice; any old key
+	   goes now and the new one is written two frames on, once the state
+	   is known to be there */
+	warmboot_drop_key();
+	machine().schedule_save(name + ".sta");
+	m_warmboot_pending = 2;
+}
+
+
+void kim1_state::warmboot_commit()
+{
+	std::string name = string_format("%s" PATH_SEPARATOR "warmboot", machine().basename());
+
+	m_warmboot_pending = 0;
+
+	emu_file statefile(machine().options().state_directory(), OPEN_FLAG_READ);
+	if (statefile.open((name + ".sta").c_str()) != osd_file::error::NONE || statefile.size() == 0)
+	{
+		logerror("warm-boot state was not written\n");
+		return;
+	}
+	statefile.close();
+
+	emu_file keyfile(machine().options().state_directory(), OPEN_FLAG_WRITE | OPEN_FLAG_CREATE | OPEN_FLAG_CREATE_PATHS);
+	if (keyfile.open((name + ".key").c_str()) != osd_file::error::NONE)
+		return;
+	if (keyfile.write(m_warmboot_key.data(), m_warmboot_key.size()) != m_warmboot_key.size())
+	{
+		keyfile.close();
+		warmboot_drop_key();
+	}
+}
+
+
+void kim1_state::warmboot_drop_key()
+{
+	/* no key, no warm boot: a half-written state is never loaded */
+	std::string name = string_format("%s" PATH_SEPARATOR "warmboot.key", machine().basename());
+
+	emu_file keyfile(machine().options().state_directory(), OPEN_FLAG_READ);
+	if (keyfile.open(name.c_str()) == osd_file::error::NONE)
+	{
+		std::string path = keyfile.fullpath();
+		keyfile.close();
+		osd_file::remove(path);
+	}
+}
+
+
+void kim1_state::warmboot_exit()
+{
+	/* a state scheduled just before exit has been written by now */
+	if (m_warmboot_pending != 0)
+		warmboot_commit();
+}
+
+
+TIMER_CALLBACK_MEMBER(kim1_state::warmboot_cycles)
+{
+	warmboot_save();
+}
+
+
+
+/*************************************
+ *
+ *  Checkpoints
+ *
+ *************************************/
+
+volatile std::sig_atomic_t kim1_state::s_checkpoint_signal = 0;
+
+void kim1_state::checkpoint_signal(int sig)
+{
+	s_checkpoint_signal = 1;
+}
+
+
+bool kim1_state::checkpoint_start()
+{
+	std::string name = string_format("%s" PATH_SEPARATOR "checkpoint", machine().basename());
+	bool resumed = false;
+
+	/* the key file holds the last complete slot, then the key */
+	emu_file keyfile(machine().options().state_directory(), OPEN_FLAG_READ);
+	if (keyfile.open((name + ".key").c_str()) == osd_file::error::NONE)
+	{
+		std::string contents(keyfile.size(), '\0');
+		keyfile.read(&contents[0], contents.size());
+		if (contents.size() > 2 && (contents[0] == '0' || contents[0] == '1') && contents.compare(2, std::string::npos, state_key()) == 0)
+		{
+			int slot = contents[0] - '0';
+			osd_printf_info("Resuming from %s-%d.sta\n", name.c_str(), slot);
+			machine().schedule_load(string_format("%s-%d.sta", name, slot));
+			m_checkpoint_slot = slot ^ 1;
+			resumed = true;
 		}
 	}
-	return 0;
+
+	/* checkpoint every KIM1_CHECKPOINT_SECS of emulated time (default 60) */
+	const char *secs = getenv("KIM1_CHECKPOINT_SECS");
+	double interval = (secs != nullptr) ? atof(secs) : 0.0;
+	if (interval <= 0.0)
+		interval = 60.0;
+	m_checkpoint_timer->adjust(attotime::from_double(interval), 0, attotime::from_double(interval));
+
+	s_checkpoint_signal = 0;
+	m_checkpoint_old_handler = std::signal(SIGTERM, &kim1_state::checkpoint_signal);
+	m_checkpoint_active = true;
+	return resumed;
+}
+
+
+TIMER_CALLBACK_MEMBER(kim1_state::checkpoint_tick)
+{
+	/* MAME writes the state at the end of this timeslice, which costs
+	   about as much as a frame; it is committed two frames on */
+	if (m_checkpoint_pending != 0)
+		checkpoint_commit();
+
+	std::string name = string_format("%s" PATH_SEPARATOR "checkpoint-%d.sta", machine().basename(), m_checkpoint_slot);
+	machine().schedule_save(std::move(name));
+	m_checkpoint_pending = 2;
+}
+
+
+void kim1_state::checkpoint_commit()
+{
+	/* point the key file at the slot just written, if it was */
+	int slot = m_checkpoint_slot;
+	std::string name = string_format("%s" PATH_SEPARATOR "checkpoint", machine().basename());
+
+	m_checkpoint_pending = 0;
+	m_checkpoint_slot ^= 1;
+
+	emu_file statefile(machine().options().state_directory(), OPEN_FLAG_READ);
+	if (statefile.open(string_format("%s-%d.sta", name, slot).c_str()) != osd_file::error::NONE || statefile.size() == 0)
+	{
+		logerror("checkpoint %d was not written\n", slot);
+		return;
+	}
+
+	std::string contents = string_format("%d %s", slot, state_key());
+	emu_file keyfile(machine().options().state_directory(), OPEN_FLAG_WRITE | OPEN_FLAG_CREATE | OPEN_FLAG_CREATE_PATHS);
+	if (keyfile.open((name + ".key").c_str()) == osd_file::error::NONE)
+		keyfile.write(contents.data(), contents.size());
+}
+
+
+void kim1_state::checkpoint_exit()
+{
+	if (!m_checkpoint_active)
+		return;
+
+	/* a checkpoint scheduled with the exit has been written by now */
+	if (m_checkpoint_pending != 0)
+		checkpoint_commit();
+
+	std::signal(SIGTERM, m_checkpoint_old_handler);
+	m_checkpoint_active = false;
+}
+
+
+
+/*************************************
+ *
+ *  Control channel
+ *
+ *************************************/
+
+TIMER_CALLBACK_MEMBER(kim1_state::control_service)
+{
+	kim1_control_header &ctl = m_control.header();
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+
+	auto sync_vram = [this, &ctl] ()
+	{
+		if (ctl.vram_serial != m_vram_serial)
+		{
+			memcpy(ctl.vram, &m_videoram[0], std::min<uint32_t>(m_videoram.bytes(), kim1_control_header::VRAM_SIZE));
+			ctl.vram_serial = m_vram_serial;
+		}
+	};
+
+	/* stopped: bring the client's view up to date, and finish the step
+	   that brought us here (param is 1 after a step) */
+	ctl.cycles = m_maincpu->total_cycles();
+	sync_vram();
+	if (param != 0)
+	{
+		if (m_wait_kind == WAIT_PC)
+			pc_unhook();
+		m_wait_kind = WAIT_NONE;
+		m_control.complete(m_wait_result);
+	}
+
+	/* wait here, inside the scheduler, so that no emulated time passes
+	   between the client's requests; the wait ends if the client goes */
+	while (m_control.wait_for_request())
+	{
+		uint32_t address = ctl.address;
+		uint32_t length = ctl.length;
+		int32_t result = 0;
+
+		switch (ctl.command)
+		{
+		case kim1_control_header::STEP:
+			if (length != 0)
+			{
+				m_wait_result = 0;
+				m_control_timer->adjust(m_maincpu->cycles_to_attotime(length), 1);
+				return;
+			}
+			break;
+
+		case kim1_control_header::WAIT_PC:
+		case kim1_control_header::WAIT_LEDS:
+		case kim1_control_header::WAIT_VRAM:
+			/* the PC hook may be the warm-boot cache's still */
+			if (ctl.command == kim1_control_header::WAIT_PC && m_pc_hook_pc != ~0)
+			{
+				result = -1;
+				break;
+			}
+
+			if (ctl.command == kim1_control_header::WAIT_PC)
+			{
+				m_wait_kind = WAIT_PC;
+				pc_hook(address & 0xffff, PC_HOOK_WAIT);
+			}
+			else if (ctl.command == kim1_control_header::WAIT_LEDS)
+			{
+				/* hex digits from the left, ? for any and space for blank */
+				static const uint8_t hex_segments[16] = { 0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f, 0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71 };
+				std::fill(std::begin(m_wait_leds), std::end(m_wait_leds), 0xff);
+				for (int i = 0; i < 6 && ctl.data[i] != 0; i++)
+				{
+					char c = ctl.data[i];
+					if (c == ' ')
+						m_wait_leds[i] = 0x00;
+					else if (isxdigit(uint8_t(c)))
+						m_wait_leds[i] = hex_segments[isdigit(uint8_t(c)) ? c - '0' : (toupper(uint8_t(c)) - 'A' + 10)];
+				}
+				m_wait_kind = WAIT_LEDS;
+			}
+			else
+			{
+				/* either window, 4000-5FFF or A000-BFFF */
+				m_wait_start = address & 0x1fff;
+				m_wait_end = ctl.end & 0x1fff;
+				m_wait_kind = WAIT_VRAM;
+			}
+
+			m_wait_result = 1;
+			m_control_timer->adjust((length != 0) ? m_maincpu->cycles_to_attotime(length) : attotime::never, 1);
+			return;
+
+		case kim1_control_header::READ:
+		case kim1_control_header::WRITE:
+			if (address > 0x10000 || length > 0x10000 - address)
+				result = -1;
+			else if (ctl.command == kim1_control_header::READ)
+			{
+				/* a look, as the debugger takes it, must not pop or
+				   acknowledge anything */
+				auto dis = machine().disable_side_effect();
+				for (uint32_t i = 0; i < length; i++)
+					ctl.data[i] = space.read_byte(address + i);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < length; i++)
+					space.write_byte(address + i, ctl.data[i]);
+				sync_vram();
+			}
+			break;
+
+		case kim1_control_header::SET_PC:
+			m_maincpu->set_state_int(M6502_PC, address & 0xffff);
+			break;
+
+		case kim1_control_header::KEYS:
+			m_control_keys = address;
+			break;
+
+		case kim1_control_header::TEXT:
+		case kim1_control_header::LEARN:
+			if (address >= TEXT_ROWS)
+				result = -1;
+			else if (ctl.command == kim1_control_header::TEXT)
+			{
+				text_capture();
+				memcpy(ctl.data, text_row(address), TEXT_COLS + 1);
+			}
+			else
+			{
+				ctl.data[TEXT_COLS] = 0;
+				ctl.length = text_learn(address, reinterpret_cast<const char *>(ctl.data));
+			}
+			break;
+
+		case kim1_control_header::SAVE:
+			snapshot_take(m_snap, m_maincpu->state_int(M6502_PC));
+			if (m_snap.size() > kim1_control_header::DATA_SIZE)
+				result = -1;
+			else
+			{
+				memcpy(ctl.data, &m_snap[0], m_snap.size());
+				ctl.length = m_snap.size();
+			}
+			break;
+
+		case kim1_control_header::RESTORE:
+			/* only a snapshot of this machine's size will do */
+			snapshot_take(m_snap, 0);
+			if (length != m_snap.size())
+				result = -1;
+			else
+			{
+				memcpy(&m_snap[0], ctl.data, length);
+				snapshot_restore(nullptr, 0);
+				sync_vram();
+			}
+			break;
+
+		case kim1_control_header::EXIT:
+			m_control.complete(0);
+			machine().schedule_exit();
+			return;
+
+		default:
+			result = -1;
+			break;
+		}
+
+		m_control.complete(result);
+	}
+
+	/* the client has gone, so there is no one to run for */
+	m_control.close();
+	machine().schedule_exit();
+}
+
+
+void kim1_state::wait_fired()
+{
+	/* stop after this instruction, with the client's request done */
+	m_wait_kind = WAIT_NONE;
+	m_wait_result = 0;
+	m_control_timer->adjust(attotime::zero, 1);
+	m_maincpu->abort_timeslice();
+}
+
+
+
+/*************************************
+ *
+ *  Differential check
+ *
+ *************************************/
+
+void kim1_state::diff_point()
+{
+	/* mid-way through a ROM routine the native and emulated versions
+	   legitimately differ, but both come out of it on the same cycle; the
+	   check is made at the first instruction boundary from here on where
+	   the next opcode is outside ROM, which is the same on both sides */
+	offs_t pc = m_maincpu->state_int(M6502_PC);
+
+	if (!in_rom(pc))
+	{
+		if (m_diff_watching)
+			diff_watch(false);
+		diff_check();
+	}
+	else if (diff_leaves_rom(pc, m_maincpu->state_int(M6502_IR)))
+	{
+		/* the opcode already fetched leaves ROM: run it, then check */
+		attotime next = m_maincpu->local_time() + m_maincpu->cycles_to_attotime(1);
+		m_diff_timer->adjust(next - machine().time());
+	}
+	else if (!m_diff_watching)
+		diff_watch(true);
+}
+
+
+TIMER_CALLBACK_MEMBER(kim1_state::diff_step)
+{
+	diff_point();
+}
+
+
+bool kim1_state::diff_leaves_rom(offs_t pc, uint8_t opcode)
+{
+	/* where an RTS, RTI, JMP or JSR fetched at pc goes; anything else
+	   stays in ROM, or near enough */
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+	uint8_t sp = m_maincpu->state_int(M6502_S);
+	offs_t operand = m_rom[(pc + 1) & 0xffff] | (m_rom[(pc + 2) & 0xffff] << 8);
+	offs_t target;
+
+	switch (opcode)
+	{
+	case 0x20:  /* JSR abs */
+	case 0x4c:  /* JMP abs */
+		target = operand;
+		break;
+
+	case 0x6c:  /* JMP (ind), with the NMOS page wrap */
+		target = space.read_byte(operand) | (space.read_byte((operand & 0xff00) | ((operand + 1) & 0xff)) << 8);
+		break;
+
+	case 0x60:  /* RTS */
+		target = (space.read_byte(0x100 | uint8_t(sp + 1)) | (space.read_byte(0x100 | uint8_t(sp + 2)) << 8)) + 1;
+		break;
+
+	case 0x40:  /* RTI */
+		target = space.read_byte(0x100 | uint8_t(sp + 2)) | (space.read_byte(0x100 | uint8_t(sp + 3)) << 8);
+		break;
+
+	default:
+		return false;
+	}
+
+	return !in_rom(target & 0xffff);
+}
+
+
+void kim1_state::diff_watch(bool watch)
+{
+	m_diff_watching = watch;
+	rom_handlers_install();
+}
+
+
+uint8_t kim1_state::diff_watch_read(address_space &space, offs_t pc)
+{
+	/* pass the read on to the hooks the byte may be covered by */
+	bool nested = m_hle_active;
+	uint8_t data;
+
+	if (m_monitor_hle && pc >= 0x1efe && pc <= 0x1f90)
+		data = monitor_hle_r(space, pc - 0x1efe);
+	else if (m_kvos_mode && pc >= 0xf000)
+		data = kvos_hook_r(space, pc - 0xf000);
+	else
+		data = m_rom[pc];
+
+	/* an opcode on its way out: stop before it, then step over it */
+	if (m_maincpu->get_sync() && !nested && !machine().side_effect_disabled() && diff_leaves_rom(pc, data))
+	{
+		m_diff_timer->adjust(attotime::zero);
+		m_maincpu->abort_timeslice();
+	}
+	return data;
+}
+
+
+READ8_MEMBER(kim1_state::diff_watch_monitor_r)
+{
+	return diff_watch_read(space, 0x1800 + offset);
+}
+
+
+READ8_MEMBER(kim1_state::diff_watch_kvos_r)
+{
+	return diff_watch_read(space, 0xf000 + offset);
+}
+
+
+void kim1_state::rom_handlers_install()
+{
+	/* the ROM, under whichever of the differential watch, the monitor
+	   HLE and KVOS hooks and a PC hook are active */
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+
+	space.install_rom(0x1800, 0x1fff, &m_rom[0x1800]);
+	space.install_rom(0xf000, 0xffff, &m_rom[0xf000]);
+	if (m_diff_watching)
+	{
+		space.install_read_handler(0x1800, 0x1fff, read8_delegate(FUNC(kim1_state::diff_watch_monitor_r), this));
+		space.install_read_handler(0xf000, 0xffff, read8_delegate(FUNC(kim1_state::diff_watch_kvos_r), this));
+	}
+	else
+	{
+		if (m_monitor_hle)
+			space.install_read_handler(0x1efe, 0x1f90, read8_delegate(FUNC(kim1_state::monitor_hle_r), this));
+		if (m_kvos_mode)
+			space.install_read_handler(0xf000, 0xffff, read8_delegate(FUNC(kim1_state::kvos_hook_r), this));
+	}
+	if (m_pc_hook_pc != ~0 && in_rom(m_pc_hook_pc))
+		space.install_read_handler(m_pc_hook_pc, m_pc_hook_pc, read8_delegate(FUNC(kim1_state::pc_hook_r), this));
+}
+
+
+bool kim1_state::diff_page_compared(int page)
+{
+	/* the RAM, video and banked windows and the RIOT RAM page */
+	return page < 0x04 || page == 0x17 || (page >= 0x20 && page < 0x64) || (page >= 0x80 && page < 0xa0);
+}
+
+
+void kim1_state::diff_snapshot(kim1_diff_snapshot &snap)
+{
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+
+	snap.pc = m_maincpu->state_int(M6502_PC);
+	snap.a = m_maincpu->state_int(M6502_A);
+	snap.x = m_maincpu->state_int(M6502_X);
+	snap.y = m_maincpu->state_int(M6502_Y);
+	snap.p = m_maincpu->state_int(M6502_P);
+	snap.sp = m_maincpu->state_int(M6502_S);
+	snap.cycles = m_maincpu->total_cycles();
+
+	for (int page = 0; page < kim1_diff_snapshot::PAGES; page++)
+	{
+		if (!diff_page_compared(page))
+			continue;
+
+		uint8_t *dst = &snap.memory[page << 8];
+
+		if (page >= 0x40 && page < 0x60)
+		{
+			/* video pages: only those holding rows written since the last check */
+			offs_t start = (page - 0x40) << 8;
+			int first = start / VRAM_PITCH, last = std::min((start + 0xff) / VRAM_PITCH, VRAM_ROWS - 1);
+			bool dirty = m_diff_full;
+
+			for (int row = first; row <= last && !dirty; row++)
+				dirty = vram_row_dirty(row, m_diff_serial);
+			if (!dirty)
+				continue;
+
+			memcpy(dst, &m_videoram[start], 0x100);
+		}
+		else if (page == 0x17)
+		{
+			/* the RIOT RAM, not its registers */
+			for (int i = 0x80; i < 0x100; i++)
+				dst[i] = space.read_byte(0x1700 + i);
+		}
+		else
+		{
+			/* other pages: only those whose contents have changed */
+			const uint8_t *src = reinterpret_cast<const uint8_t *>(space.get_read_ptr(page << 8));
+			uint8_t buffer[0x100];
+
+			if (src == nullptr)
+			{
+				for (int i = 0; i < 0x100; i++)
+					buffer[i] = space.read_byte((page << 8) + i);
+				src = buffer;
+			}
+
+			if (!m_diff_full && memcmp(dst, src, 0x100) == 0)
+				continue;
+
+			memcpy(dst, src, 0x100);
+		}
+
+		/* FNV-1a, so the peer compares a word a page */
+		uint32_t hash = 2166136261U;
+		for (int i = 0; i < 0x100; i++)
+			hash = (hash ^ dst[i]) * 16777619U;
+		snap.page_hash[page] = hash;
+	}
+
+	m_diff_serial = m_vram_serial;
+	m_diff_full = false;
+}
+
+
+bool kim1_state::diff_compare(const kim1_diff_snapshot &mine, const kim1_diff_snapshot &peer)
+{
+	const kim1_diff_snapshot &ref = m_diff_side ? peer : mine;
+	const kim1_diff_snapshot &fast = m_diff_side ? mine : peer;
+	int page;
+
+	for (page = 0; page < kim1_diff_snapshot::PAGES; page++)
+		if (diff_page_compared(page) && ref.page_hash[page] != fast.page_hash[page])
+			break;
+
+	bool regs_match = ref.pc == fast.pc && ref.a == fast.a && ref.x == fast.x && ref.y == fast.y && ref.p == fast.p && ref.sp == fast.sp && ref.cycles == fast.cycles;
+	if (regs_match && page == kim1_diff_snapshot::PAGES)
+		return true;
+
+	osd_printf_error("Differential check failed at check %u, %s\n", m_diff_count, machine().time().as_string());
+	osd_printf_error("  reference: PC=%04X A=%02X X=%02X Y=%02X P=%02X S=%02X cycles=%llu\n", ref.pc, ref.a, ref.x, ref.y, ref.p, ref.sp, (unsigned long long)ref.cycles);
+	osd_printf_error("  fast:      PC=%04X A=%02X X=%02X Y=%02X P=%02X S=%02X cycles=%llu\n", fast.pc, fast.a, fast.x, fast.y, fast.p, fast.sp, (unsigned long long)fast.cycles);
+	if (page != kim1_diff_snapshot::PAGES)
+	{
+		int offset = 0;
+		while (offset < 0xff && ref.memory[(page << 8) + offset] == fast.memory[(page << 8) + offset])
+			offset++;
+		offs_t address = (page << 8) + offset;
+		osd_printf_error("  memory:    first difference at %04X, reference %02X, fast %02X\n", address, ref.memory[address], fast.memory[address]);
+	}
+	return false;
+}
+
+
+void kim1_state::diff_check()
+{
+	uint32_t check = m_diff_count;
+
+	/* don't overwrite the snapshot the peer may still be reading */
+	if (check > 0 && !m_diff.wait_for_compared(check - 1))
+		return;
+
+	diff_snapshot(m_diff.mine());
+	m_diff.publish(check);
+
+	bool ok = true;
+	if (m_diff.wait_for_published(check))
+		ok = diff_compare(m_diff.mine(), m_diff.peer());
+	m_diff.compared(check);
+	m_diff_count++;
+
+	if (!ok)
+		machine().schedule_exit();
 }
 
 
@@ -458,6 +2788,8 @@ WRITE8_MEMBER(kim1_state::missile_w)
     if (1==1)
     {
 		m_videoram[offset] = data;
+		mark_vram_dirty(offset);
+		perf_count(kim1_perf_device::COUNTER_VRAM_WRITES);
 		return;
 	}
 
@@ -518,6 +2850,123 @@ WRITE8_MEMBER(kim1_state::missile_w)
 }
 
 
+void kim1_state::arena_allocate()
+{
+	address_space &space = m_maincpu->space(AS_PROGRAM);
+
+	/* the pieces, hottest first: zero page and stack, the 6530 RAM, then
+	   video, colour, expansion and banked RAM */
+	const uint32_t sizes[] = { 0x400, 0x80, m_videoram.bytes(), m_colorram.bytes(), m_ram.bytes(), XRAM_BANKS * XRAM_BANK_SIZE };
+	uint32_t offsets[ARRAY_LENGTH(sizes)];
+
+	m_arena_size = 0;
+	for (int i = 0; i < ARRAY_LENGTH(sizes); i++)
+	{
+		offsets[i] = m_arena_size;
+		m_arena_size += (sizes[i] + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	}
+
+	/* one block, aligned by hand so every piece starts a cache line */
+	m_arena = make_unique_clear<uint8_t[]>(m_arena_size + ARENA_ALIGN - 1);
+	uint8_t *base = m_arena.get() + (-uintptr_t(m_arena.get()) & (ARENA_ALIGN - 1));
+
+	uint8_t *low = base + offsets[0];
+	uint8_t *riot = base + offsets[1];
+	space.install_ram(0x0000, 0x03ff, low);
+	space.install_ram(0x1780, 0x17ff, riot);
+	save_pointer(low, "arena_low", sizes[0]);
+	save_pointer(riot, "arena_riot", sizes[1]);
+
+	/* the shares keep their own memory as the save state backing */
+	memcpy(base + offsets[2], m_videoram, sizes[2]);
+	m_videoram.set_target(base + offsets[2], sizes[2]);
+	memcpy(base + offsets[3], m_colorram, sizes[3]);
+	space.install_ram(0x6000, 0x63ff, base + offsets[3]);
+	m_colorram.set_target(base + offsets[3], sizes[3]);
+	m_arena_ram = base + offsets[4];
+	memcpy(m_arena_ram, m_ram, sizes[4]);
+	space.install_ram(0x2000, 0x3fff, m_arena_ram);
+	m_ram.set_target(m_arena_ram, sizes[4]);
+
+	m_xram = base + offsets[5];
+
+	osd_printf_verbose("KIM-1 arena: %u bytes\n", m_arena_size);
+}
+
+
+READ8_MEMBER(kim1_state::xram_bank_r)
+{
+	return m_xram_latch;
+}
+
+
+WRITE8_MEMBER(kim1_state::xram_bank_w)
+{
+	m_xram_latch = data & (XRAM_BANKS - 1);
+	m_xram_bank->set_entry(m_xram_latch);
+}
+
+
+void kim1_state::xram_postload()
+{
+	m_xram_bank->set_entry(m_xram_latch);
+}
+
+
+/* The two CPUs run in timeslices of their own; these writes are passed
+   across through synchronize() so the other side sees them at the right
+   time, and the interleave is boosted so a handshake completes quickly. */
+
+READ8_MEMBER(kim1_state::copro_status_r)
+{
+	uint8_t data = m_copro_status;
+
+	if (!machine().side_effect_disabled() && data)
+		machine().scheduler().synchronize(timer_expired_delegate(FUNC(kim1_state::copro_status_sync), this), 0);
+
+	return data;
+}
+
+
+WRITE8_MEMBER(kim1_state::copro_control_w)
+{
+	machine().scheduler().synchronize(timer_expired_delegate(FUNC(kim1_state::copro_control_sync), this), data & 0x03);
+	machine().scheduler().boost_interleave(attotime::zero, attotime::from_usec(100));
+}
+
+
+READ8_MEMBER(kim1_state::copro_ack_r)
+{
+	uint8_t data = m_copro_control;
+
+	if (!machine().side_effect_disabled() && (data & 0x02))
+		machine().scheduler().synchronize(timer_expired_delegate(FUNC(kim1_state::copro_control_sync), this), data & ~0x02);
+
+	return data;
+}
+
+
+WRITE8_MEMBER(kim1_state::copro_doorbell_w)
+{
+	machine().scheduler().synchronize(timer_expired_delegate(FUNC(kim1_state::copro_status_sync), this), 1);
+	machine().scheduler().boost_interleave(attotime::zero, attotime::from_usec(100));
+}
+
+
+TIMER_CALLBACK_MEMBER(kim1_state::copro_control_sync)
+{
+	m_copro_control = param;
+	m_copro->set_input_line(INPUT_LINE_RESET, (param & 0x01) ? CLEAR_LINE : ASSERT_LINE);
+	m_copro->set_input_line(M6502_IRQ_LINE, (param & 0x02) ? ASSERT_LINE : CLEAR_LINE);
+}
+
+
+TIMER_CALLBACK_MEMBER(kim1_state::copro_status_sync)
+{
+	m_copro_status = param;
+}
+
+
 READ8_MEMBER(kim1_state::missile_r)
 {
 	uint8_t result = 0xff;
@@ -590,17 +3039,23 @@ static MACHINE_CONFIG_START( kim1 )
 	// basic machine hardware
 	MCFG_CPU_ADD("maincpu", M6502, 1000000)        /* 1 MHz */
 	MCFG_CPU_PROGRAM_MAP(kim1_map)
+	MCFG_CPU_IRQ_ACKNOWLEDGE_DRIVER(kim1_state, kim1_irq_ack)
+	MCFG_M6502_SYNC_CALLBACK(WRITELINE(kim1_state, kim1_sync_w))
 	MCFG_QUANTUM_TIME(attotime::from_hz(60))
 
+	MCFG_CPU_ADD("copro", M6502, 1000000)          /* 1 MHz */
+	MCFG_CPU_PROGRAM_MAP(kim1_copro_map)
+
 // <hack value="20170808-2049">
 	//MCFG_WATCHDOG_ADD("watchdog")
 	//MCFG_WATCHDOG_VBLANK_INIT("screen", 8)
 
-	MCFG_PALETTE_ADD("palette", 8)
+	MCFG_PALETTE_ADD_3BIT_RGB("palette")
 
 	MCFG_SCREEN_ADD("screen", RASTER)
 	MCFG_SCREEN_RAW_PARAMS(PIXEL_CLOCK, HTOTAL, HBEND, HBSTART, VTOTAL, VBEND, VBSTART)
 	MCFG_SCREEN_UPDATE_DRIVER(kim1_state, screen_update_kim1)
+	MCFG_SCREEN_VBLANK_CALLBACK(WRITELINE(kim1_state, screen_vblank_kim1))
 	MCFG_SCREEN_PALETTE("palette")
 // </hack>
 	// video hardware
@@ -615,6 +3070,15 @@ static MACHINE_CONFIG_START( kim1 )
 
 	MCFG_DEVICE_ADD("miot_u3", MOS6530, 1000000)
 
+	MCFG_DEVICE_ADD("hostcall", KIM1_HOSTCALL, 0)
+	MCFG_DEVICE_ADD("blkdev", KIM1_BLKDEV, 0)
+	MCFG_DEVICE_ADD("hostfs", KIM1_HOSTFS, 0)
+	MCFG_DEVICE_ADD("dma", KIM1_DMA, 0)
+	MCFG_KIM1_DMA_IRQ_HANDLER(INPUTLINE("maincpu", M6502_IRQ_LINE))
+	MCFG_DEVICE_ADD("apu", KIM1_APU, 2000000)
+	MCFG_DEVICE_ADD("perf", KIM1_PERF, 0)
+	MCFG_KIM1_PERF_CPU("maincpu")
+
 	MCFG_CASSETTE_ADD( "cassette" )
 	MCFG_CASSETTE_FORMATS(kim1_cassette_formats)
 	MCFG_CASSETTE_DEFAULT_STATE(CASSETTE_STOPPED)
@@ -628,6 +3092,13 @@ static MACHINE_CONFIG_START( kim1 )
 
 MACHINE_CONFIG_END
 
+static MACHINE_CONFIG_DERIVED( kim1c, kim1 )
+	MCFG_CPU_REPLACE("maincpu", M65C02, 1000000)        /* 1 MHz */
+	MCFG_CPU_PROGRAM_MAP(kim1_map)
+	MCFG_CPU_IRQ_ACKNOWLEDGE_DRIVER(kim1_state, kim1_irq_ack)
+	MCFG_M6502_SYNC_CALLBACK(WRITELINE(kim1_state, kim1_sync_w))
+MACHINE_CONFIG_END
+
 //**************************************************************************
 //  ROM DEFINITIONS
 //**************************************************************************
@@ -642,9 +3113,13 @@ ROM_START(kim1)
     ROM_LOAD("kvos-001-derivative-resetvector1c22.bin",	0xf000, 0x1000, CRC(a2e56d03) SHA1(b932add2cb15af2409015284308821d74bcccd11))
 
 ROM_END
+
+#define rom_kim1c rom_kim1
+
 //**************************************************************************
 //  SYSTEM DRIVERS
 //**************************************************************************
 
 //    YEAR  NAME      PARENT    COMPAT  MACHINE   INPUT  CLASS           INIT  COMPANY             FULLNAME  FLAGS
 COMP( 1975, kim1,     0,        0,      kim1,     kim1,  kim1_state,     0,    "MOS Technologies", "KIM-1" , MACHINE_NO_SOUND_HW | MACHINE_SUPPORTS_SAVE)
+COMP( 1975, kim1c,    kim1,     0,      kim1c,    kim1,  kim1_state,     0,    "MOS Technologies", "KIM-1 (65C02)" , MACHINE_NO_SOUND_HW | MACHINE_SUPPORTS_SAVE)
@@ -13,36 +13,94 @@
 
 #include "softlist.h"
 #include "cpu/m6502/m6502.h"
+#include "cpu/m6502/m65c02.h"
 #include "machine/mos6530.h"
 #include "imagedev/cassette.h"
 #include "formats/kim1_cas.h"
+#include "machine/kim1_apu.h"
+#include "machine/kim1_blkdev.h"
+#include "machine/kim1_dma.h"
+#include "machine/kim1_hostcall.h"
+#include "machine/kim1_hostfs.h"
+#include "machine/kim1_perf.h"
+#include "machine/kim1_shm.h"
+#include "machine/kim1_snap.h"
+
+#include <csignal>
+#include <functional>
+#include <map>
+#include <unordered_map>
 
 //**************************************************************************
 //  TYPE DEFINITIONS
 //**************************************************************************
 
+// CPU registers as seen by a native KVOS routine
+struct kvos_regs
+{
+	uint8_t a, x, y, p;
+};
+
+// a native KVOS routine; updates the registers and returns the cycles the
+// 6502 code would have taken
+typedef std::function<int (kvos_regs &regs)> kvos_native_func;
+
 class kim1_state : public driver_device
 {
 public:
 	kim1_state(const machine_config &mconfig, device_type type, const char *tag)
 		: driver_device(mconfig, type, tag),
 		m_maincpu(*this, "maincpu"),
+		m_copro(*this, "copro"),
+		m_rom(*this, "maincpu"),
+		m_ram(*this, "ram"),
 		m_videoram(*this, "videoram"),		
+		m_colorram(*this, "colorram"),
+		m_mailbox(*this, "mailbox"),
 		m_riot2(*this, "miot_u2"),
 		m_cass(*this, "cassette"),
+		m_hostcall(*this, "hostcall"),
+		m_hostfs(*this, "hostfs"),
+		m_apu(*this, "apu"),
+		m_perf(*this, "perf"),
+		m_blkdev(*this, "blkdev"),
+		m_dma(*this, "dma"),
+		m_xram_bank(*this, "xram"),
 		m_screen(*this, "screen"),
 		m_palette(*this, "palette"),
 		m_row0(*this, "ROW0"),
 		m_row1(*this, "ROW1"),
 		m_row2(*this, "ROW2"),
-		m_special(*this, "SPECIAL")
+		m_special(*this, "SPECIAL"),
+		m_config(*this, "CONFIG")
 		 { }
 
+	enum
+	{
+		VRAM_PITCH = 40,                    // bytes per pixel row
+		VRAM_ROWS = 200,                    // pixel rows in the bitmap
+		TEXT_COLS = VRAM_PITCH,             // 8x8 character cells across
+		TEXT_ROWS = VRAM_ROWS / 8,          // 8x8 character cells down
+		THUMB_COLS = VRAM_PITCH * 8 / 4,    // 4x4 pixel blocks across
+		THUMB_ROWS = VRAM_ROWS / 4          // 4x4 pixel blocks down
+	};
+
 	// devices
-	required_device<cpu_device> m_maincpu;
+	required_device<m6502_device> m_maincpu;
+	required_device<m6502_device> m_copro;
+	required_region_ptr<uint8_t> m_rom;
+	required_shared_ptr<uint8_t> m_ram;
 	required_shared_ptr<uint8_t> m_videoram;	
+	required_shared_ptr<uint8_t> m_colorram;
+	required_shared_ptr<uint8_t> m_mailbox;
 	required_device<mos6530_device> m_riot2;
 	required_device<cassette_image_device> m_cass;
+	required_device<kim1_hostcall_device> m_hostcall;
+	required_device<kim1_hostfs_device> m_hostfs;
+	required_device<kim1_apu_device> m_apu;
+	required_device<kim1_perf_device> m_perf;
+	required_device<kim1_blkdev_device> m_blkdev;
+	required_device<kim1_dma_device> m_dma;
 	DECLARE_READ8_MEMBER(kim1_u2_read_a);
 	DECLARE_WRITE8_MEMBER(kim1_u2_write_a);
 	DECLARE_READ8_MEMBER(kim1_u2_read_b);
@@ -51,6 +109,7 @@ public:
 	uint8_t m_311_output;
 	uint32_t m_cassette_high_count;
 	uint8_t m_led_time[6];
+	void led_set(int digit, uint8_t segments);
 	
 	required_device<screen_device> m_screen;
 	required_device<palette_device> m_palette;
@@ -60,13 +119,100 @@ public:
 	DECLARE_WRITE8_MEMBER(missile_w);
 	DECLARE_READ8_MEMBER(missile_r);
 
+	// per-instance arena
+	void arena_allocate();
+
+	// banked RAM card
+	DECLARE_READ8_MEMBER(xram_bank_r);
+	DECLARE_WRITE8_MEMBER(xram_bank_w);
+	void xram_postload();
+
+	// snapshot store port
+	DECLARE_READ8_MEMBER(snap_r);
+	DECLARE_WRITE8_MEMBER(snap_w);
+	void snapshot_take(std::vector<uint8_t> &snap, uint16_t pc);
+	TIMER_CALLBACK_MEMBER(snapshot_save);
+	TIMER_CALLBACK_MEMBER(snapshot_restore);
+	template <typename Visitor> void snapshot_visit(Visitor &&visit);
+	bool snapshot_store_open(bool create);
+
+	// PC hook
+	enum { PC_HOOK_WARMBOOT, PC_HOOK_WAIT };
+	void pc_hook(offs_t pc, int owner);
+	void pc_unhook();
+	DECLARE_READ8_MEMBER(pc_hook_r);
+
+	// warm-boot cache
+	std::string state_key();
+	void warmboot_start();
+	void warmboot_save();
+	void warmboot_commit();
+	void warmboot_drop_key();
+	void warmboot_exit();
+	TIMER_CALLBACK_MEMBER(warmboot_cycles);
+
+	// checkpoints
+	bool checkpoint_start();
+	void checkpoint_commit();
+	void checkpoint_exit();
+	TIMER_CALLBACK_MEMBER(checkpoint_tick);
+	static void checkpoint_signal(int sig);
+
+	// control channel
+	TIMER_CALLBACK_MEMBER(control_service);
+	void wait_fired();
+
+	// coprocessor card
+	DECLARE_READ8_MEMBER(copro_status_r);
+	DECLARE_WRITE8_MEMBER(copro_control_w);
+	DECLARE_READ8_MEMBER(copro_ack_r);
+	DECLARE_WRITE8_MEMBER(copro_doorbell_w);
+	TIMER_CALLBACK_MEMBER(copro_control_sync);
+	TIMER_CALLBACK_MEMBER(copro_status_sync);
+
 	// device overrides
 	virtual void machine_start() override;
 	virtual void machine_reset() override;
 	
 	uint32_t screen_update_kim1(screen_device &screen, bitmap_rgb32 &bitmap, const rectangle &cliprect);
+	DECLARE_WRITE_LINE_MEMBER(screen_vblank_kim1);
+
+	// text extraction
+	uint32_t text_update();
+	const char *text_row(int row) const { return m_text[row]; }
+	int text_learn(int row, const char *text);
+	void text_capture();
 
-	//inline int scanline_to_v(int scanline);
+	// greyscale thumbnail, one byte per 4x4 block
+	const uint8_t *thumbnail_update();
+
+	// differential check against a second machine
+	static bool in_rom(offs_t pc) { return (pc >= 0x1800 && pc < 0x2000) || pc >= 0xf000; }
+	static bool diff_page_compared(int page);
+	void diff_point();
+	TIMER_CALLBACK_MEMBER(diff_step);
+	bool diff_leaves_rom(offs_t pc, uint8_t opcode);
+	void diff_watch(bool watch);
+	uint8_t diff_watch_read(address_space &space, offs_t pc);
+	DECLARE_READ8_MEMBER(diff_watch_monitor_r);
+	DECLARE_READ8_MEMBER(diff_watch_kvos_r);
+	void rom_handlers_install();
+	void diff_check();
+	void diff_snapshot(kim1_diff_snapshot &snap);
+	bool diff_compare(const kim1_diff_snapshot &mine, const kim1_diff_snapshot &peer);
+
+	inline int scanline_to_vram_row(int scanline) const;
+	inline void mark_vram_dirty(offs_t offset);
+	void mark_vram_dirty_range(offs_t start, offs_t end);
+	inline bool vram_row_dirty(int row, uint32_t since) const;
+	void vram_postload();
+	void backing_presave();
+	void backing_postload();
+	void shm_frame();
+	void nvram_open();
+	void nvram_exit();
+	inline uint64_t text_cell(int row, int col) const;
+	inline const uint32_t *attr_expansion(uint8_t attr);
 	//inline int v_to_scanline(int v);
 	//inline void schedule_next_irq(int curv);
 	inline bool get_madsel();
@@ -74,16 +220,196 @@ public:
 	void write_vram(address_space &space, offs_t address, uint8_t data);
 	uint8_t read_vram(address_space &space, offs_t address);
 
+	// monitor display/keypad HLE
+	DECLARE_READ8_MEMBER(monitor_hle_r);
+	void monitor_hle_scands(address_space &space);
+	void monitor_hle_ak(address_space &space, int cycles);
+	void monitor_hle_getkey(address_space &space, int cycles);
+	void monitor_hle_return(uint8_t a, uint8_t x, uint8_t y, uint8_t nz, int cycles);
+	uint8_t keypad_row(int row);
+
+	// KVOS native routines
+	void kvos_register(offs_t entry, const char *name, kvos_native_func func);
+	uint32_t kvos_mismatches() const { return m_kvos_mismatches; }
+	void kvos_exit();
+	uint8_t kvos_read(offs_t address);
+	void kvos_write(offs_t address, uint8_t data);
+	void kvos_fill(offs_t address, int count, uint8_t data);
+	DECLARE_READ8_MEMBER(kvos_hook_r);
+	void kvos_verify();
+	int kvos_clear_window(kvos_regs &regs);
+	int kvos_plot(kvos_regs &regs);
+
 	DECLARE_INPUT_CHANGED_MEMBER(trigger_reset);
 	DECLARE_INPUT_CHANGED_MEMBER(trigger_nmi);
+	IRQ_CALLBACK_MEMBER(kim1_irq_ack);
+	DECLARE_WRITE_LINE_MEMBER(kim1_sync_w);
+	void perf_count(int counter) { if (m_perf_mapped) m_perf->count(counter); }
 	TIMER_DEVICE_CALLBACK_MEMBER(kim1_cassette_input);
 	TIMER_DEVICE_CALLBACK_MEMBER(kim1_update_leds);
+	TIMER_CALLBACK_MEMBER(kim1_link_sync);
+	uint64_t link_now() const { return machine().time().as_ticks(1000000); }
 
 protected:
 	required_ioport m_row0;
 	required_ioport m_row1;
 	required_ioport m_row2;
 	required_ioport m_special;
+	required_ioport m_config;
+
+	// video write tracking: every write to the bitmap stamps its row with a
+	// new serial, so any number of consumers can find the rows changed since
+	// the serial they last looked at
+	uint32_t m_vram_serial;
+	uint32_t m_vram_row_serial[VRAM_ROWS];
+
+	// text extraction state
+	std::unordered_map<uint64_t, char> m_glyphs;
+	char m_text[TEXT_ROWS][TEXT_COLS + 1];
+	uint32_t m_text_serial;
+	bool m_text_valid;
+
+	// thumbnail state
+	uint8_t m_thumbnail[THUMB_ROWS * THUMB_COLS];
+	uint32_t m_thumb_serial;
+	bool m_thumb_valid;
+
+	// colour attribute rendering: for each fg/bg pair in use, the eight
+	// pixels of every bitmap byte already expanded to RGB
+	std::unique_ptr<uint32_t[]> m_attr_cache[64];
+
+	bool m_cmos;                        // a 65C02: no native paths, their cycle counts are NMOS
+	bool m_monitor_hle;
+	bool m_hle_active;                  // native code is running; hooks stand down
+	bool m_hostcall_mapped;
+	bool m_hostfs_mapped;
+	bool m_snap_mapped;
+	bool m_blkdev_mapped;
+	bool m_xram_mapped;
+	bool m_dma_mapped;
+	bool m_apu_mapped;
+	bool m_perf_mapped;
+	bool m_copro_mapped;
+
+	// host shared-memory backing for the expansion RAM and video window
+	kim1_shared_memory m_shm;
+
+	// memory-mapped battery-backed expansion RAM
+	kim1_mapped_nvram m_nvram;
+
+	// serial link to another machine on the TTY lines (PB0 out, PA7 in);
+	// line changes arrive LINK_LOOKAHEAD microseconds after they are sent,
+	// and the sides synchronise every LINK_PERIOD microseconds
+	enum { LINK_LOOKAHEAD = 1000, LINK_PERIOD = 1000 };
+	kim1_serial_link m_link;
+	emu_timer *m_link_timer;
+	bool m_link_broken;
+	uint8_t m_link_tx;
+	uint8_t m_link_rx;
+
+	// control channel to a libkim1 client; keys are held as a bitmask
+	// of the three keypad rows, seven bits each
+	kim1_control_channel m_control;
+	emu_timer *m_control_timer;
+	uint32_t m_control_keys;
+
+	// an event the client is waiting for; the machine stops when it happens
+	// or the cycle limit runs out, whichever is first
+	enum { WAIT_NONE, WAIT_PC, WAIT_LEDS, WAIT_VRAM };
+	int m_wait_kind;
+	int32_t m_wait_result;              // 0 if it happened, 1 if the limit ran out
+	offs_t m_wait_start;
+	offs_t m_wait_end;
+	uint8_t m_wait_leds[6];             // segments, or 0xff for any
+	uint8_t m_led_segments[6];          // segments lit, 0 once a digit fades
+
+	// differential check: one side runs the reference paths, the other the
+	// fast paths, and their snapshots are compared once a frame, at the
+	// first instruction outside ROM
+	kim1_diff_channel m_diff;
+	int m_diff_side;
+	uint32_t m_diff_count;
+	uint32_t m_diff_serial;
+	bool m_diff_full;
+	bool m_diff_watching;               // ROM fetches are watched for a way out
+	emu_timer *m_diff_timer;
+
+	// banked RAM card: XRAM_BANKS banks of 8 KB seen through 8000-9FFF
+	enum { XRAM_BANKS = 16, XRAM_BANK_SIZE = 0x2000 };
+	required_memory_bank m_xram_bank;
+	uint8_t *m_xram;
+	uint8_t m_xram_latch;
+
+	// per-instance arena: all the RAM the driver places itself, in one
+	// block, hottest first
+	enum { ARENA_ALIGN = 64 };
+	std::unique_ptr<uint8_t[]> m_arena;
+	uint32_t m_arena_size;
+	uint8_t *m_arena_ram;               // where the 2000-3FFF RAM lives when not moved out
+
+	// coprocessor card: main CPU control (bit 0 = run, bit 1 = interrupt)
+	// and coprocessor doorbell (bit 0 = rung)
+	uint8_t m_copro_control;
+	uint8_t m_copro_status;
+
+	// snapshot store: RAM, video, banked RAM and CPU registers, kept as
+	// deltas against a base in one file
+	enum { SNAP_REGS = 8 };
+	kim1_snapshot_store m_snap_store;
+	std::unique_ptr<emu_file> m_snap_file;
+	std::vector<uint8_t> m_snap;
+	uint8_t m_snap_status;
+	uint16_t m_snap_index;
+
+	bool m_first_reset_done;            // checkpoints and warm boot start at the first reset
+
+	// one PC hooked for its first opcode fetch, by the warm-boot cache or
+	// an event wait
+	offs_t m_pc_hook_pc;                // ~0 when nothing is hooked
+	uint8_t *m_pc_hook_ptr;             // what the hooked byte reads from
+	int m_pc_hook_owner;
+
+	// warm-boot cache: the state at a boot point (a cycle count, or the
+	// first fetch from a PC) saved once and loaded on later starts
+	emu_timer *m_warmboot_timer;
+	std::string m_warmboot_key;
+	int m_warmboot_pending;             // frames until the saved state is committed, or 0
+
+	// checkpoints: a state saved every interval and on SIGTERM, alternating
+	// between two slots; the key file names the last complete one
+	emu_timer *m_checkpoint_timer;
+	int m_checkpoint_slot;              // slot the next checkpoint goes to
+	int m_checkpoint_pending;           // frames until the last one is committed, or 0
+	bool m_checkpoint_active;
+	static volatile std::sig_atomic_t s_checkpoint_signal;
+	void (*m_checkpoint_old_handler)(int);
+
+	// KVOS native routines, indexed by ROM offset (0 = none, else index + 1)
+	struct kvos_native
+	{
+		offs_t entry;
+		const char *name;
+		kvos_native_func func;
+	};
+	std::vector<kvos_native> m_kvos_natives;
+	uint8_t m_kvos_hook[0x1000];
+	int m_kvos_mode;
+
+	// writes made by a native routine run in verification mode; they are
+	// kept aside and compared with what the 6502 code does
+	bool m_kvos_shadow;
+	std::map<offs_t, uint8_t> m_kvos_writes;
+	struct
+	{
+		bool active;
+		const kvos_native *native;
+		offs_t ret_pc;
+		uint8_t ret_sp;
+		kvos_regs regs;
+		std::map<offs_t, uint8_t> writes;
+	} m_kvos_pending;
+	uint32_t m_kvos_checks;
+	uint32_t m_kvos_mismatches;
 };
 
 #endif /* KIM1_H */
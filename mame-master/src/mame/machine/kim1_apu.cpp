@@ -0,0 +1,600 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 arithmetic processor card
+
+    An Am9511A-style arithmetic processor for programs that would
+    otherwise spend their time in software floating point. Operands
+    are pushed a byte at a time, least significant byte first, onto a
+    16-byte stack; a command operates on the top of stack (TOS) and
+    next on stack (NOS) and leaves its result on the stack, to be read
+    back most significant byte first.
+
+    Registers:
+        0   R/W: data (pop/push the stack)
+        1   W: command, R: status
+            (bit 7 = busy, bit 6 = sign, bit 5 = zero,
+             bits 4-1 = error, bit 0 = carry)
+
+    Operands are 16- or 32-bit two's complement integers or 32-bit
+    floats in the Am9511 format: sign in bit 31, a 7-bit two's
+    complement exponent in bits 30-24 and a normalised 24-bit
+    mantissa in bits 23-0, with zero all zero bits. The work is done
+    natively in doubles and 64-bit integers and rounded to the card's
+    formats.
+
+    The commands are those of the Am9511A, with NOS the left operand
+    (FSUB is NOS - TOS). The card reads busy for the Am9511A's typical
+    execution time at its clock, or not at all if the "Math
+    coprocessor" option is set to instant. The service request bit
+    (bit 7 of the command) is accepted but not wired to an interrupt.
+
+    FMUL of two floats at E050:
+
+        LDX #3
+    PUSH1
+        LDA ARG1,X      ; most significant byte last
+        STA $E050
+        DEX
+        BPL PUSH1       ; (push ARG2 the same way)
+        ...
+        LDA #$12        ; FMUL
+        STA $E051
+    WAIT
+        LDA $E051
+        BMI WAIT
+        LDX #0
+    PULL
+        LDA $E050       ; most significant byte first
+        STA RESULT,X
+        INX
+        CPX #4
+        BNE PULL
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_apu.h"
+
+#include <cmath>
+
+
+//**************************************************************************
+//  DEVICE DEFINITIONS
+//**************************************************************************
+
+DEFINE_DEVICE_TYPE(KIM1_APU, kim1_apu_device, "kim1_apu", "KIM-1 Arithmetic Processor Card")
+
+namespace {
+
+enum
+{
+	CMD_NOP = 0x00,
+	CMD_SQRT = 0x01,
+	CMD_SIN = 0x02,
+	CMD_COS = 0x03,
+	CMD_TAN = 0x04,
+	CMD_ASIN = 0x05,
+	CMD_ACOS = 0x06,
+	CMD_ATAN = 0x07,
+	CMD_LOG = 0x08,
+	CMD_LN = 0x09,
+	CMD_EXP = 0x0a,
+	CMD_PWR = 0x0b,
+	CMD_FADD = 0x10,
+	CMD_FSUB = 0x11,
+	CMD_FMUL = 0x12,
+	CMD_FDIV = 0x13,
+	CMD_CHSF = 0x15,
+	CMD_PTOF = 0x17,
+	CMD_POPF = 0x18,
+	CMD_XCHF = 0x19,
+	CMD_PUPI = 0x1a,
+	CMD_FLTD = 0x1c,
+	CMD_FLTS = 0x1d,
+	CMD_FIXD = 0x1e,
+	CMD_FIXS = 0x1f,
+	CMD_DADD = 0x2c,
+	CMD_DSUB = 0x2d,
+	CMD_DMUL = 0x2e,
+	CMD_DDIV = 0x2f,
+	CMD_CHSD = 0x34,
+	CMD_DMUU = 0x36,
+	CMD_PTOD = 0x37,
+	CMD_POPD = 0x38,
+	CMD_XCHD = 0x39,
+	CMD_SADD = 0x6c,
+	CMD_SSUB = 0x6d,
+	CMD_SMUL = 0x6e,
+	CMD_SDIV = 0x6f,
+	CMD_CHSS = 0x74,
+	CMD_SMUU = 0x76,
+	CMD_PTOS = 0x77,
+	CMD_POPS = 0x78,
+	CMD_XCHS = 0x79
+};
+
+inline int64_t sign_extend(uint32_t value, int bits)
+{
+	return int64_t(int32_t(value << (32 - bits)) >> (32 - bits));
+}
+
+} // anonymous namespace
+
+
+//**************************************************************************
+//  LIVE DEVICE
+//**************************************************************************
+
+//-------------------------------------------------
+//  kim1_apu_device - constructor
+//-------------------------------------------------
+
+kim1_apu_device::kim1_apu_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock)
+	: device_t(mconfig, KIM1_APU, tag, owner, clock),
+	m_instant(false),
+	m_sp(0),
+	m_status(0)
+{
+}
+
+
+//-------------------------------------------------
+//  device_start - device-specific startup
+//-------------------------------------------------
+
+void kim1_apu_device::device_start()
+{
+	memset(m_stack, 0, sizeof(m_stack));
+	m_busy_until = attotime::zero;
+
+	save_item(NAME(m_stack));
+	save_item(NAME(m_sp));
+	save_item(NAME(m_status));
+	save_item(NAME(m_busy_until));
+}
+
+
+//-------------------------------------------------
+//  device_reset - device-specific reset
+//-------------------------------------------------
+
+void kim1_apu_device::device_reset()
+{
+	m_sp = 0;
+	m_status = 0;
+	m_busy_until = attotime::zero;
+}
+
+
+//-------------------------------------------------
+//  read -
+//-------------------------------------------------
+
+READ8_MEMBER( kim1_apu_device::read )
+{
+	if (offset & 1)
+		return m_status | (machine().time() < m_busy_until ? STATUS_BUSY : 0);
+
+	if (machine().side_effect_disabled())
+		return m_stack[(m_sp - 1) & (STACK_SIZE - 1)];
+
+	return pop_byte();
+}
+
+
+//-------------------------------------------------
+//  write -
+//-------------------------------------------------
+
+WRITE8_MEMBER( kim1_apu_device::write )
+{
+	if (offset & 1)
+	{
+		int cycles = execute(data & 0x7f);
+		if (!m_instant)
+			m_busy_until = machine().time() + clocks_to_attotime(cycles);
+	}
+	else
+		push_byte(data);
+}
+
+
+//-------------------------------------------------
+//  stack access
+//-------------------------------------------------
+
+uint8_t kim1_apu_device::pop_byte()
+{
+	m_sp = (m_sp - 1) & (STACK_SIZE - 1);
+	return m_stack[m_sp];
+}
+
+void kim1_apu_device::push_byte(uint8_t data)
+{
+	m_stack[m_sp] = data;
+	m_sp = (m_sp + 1) & (STACK_SIZE - 1);
+}
+
+// index 0 is TOS, 1 is NOS
+uint32_t kim1_apu_device::get(int size, int index) const
+{
+	uint32_t value = 0;
+	int top = m_sp - index * size;
+
+	for (int i = 1; i <= size; i++)
+		value = (value << 8) | m_stack[(top - i) & (STACK_SIZE - 1)];
+
+	return value;
+}
+
+void kim1_apu_device::put(int size, int index, uint32_t value)
+{
+	int top = m_sp - index * size;
+
+	for (int i = size; i >= 1; i--)
+	{
+		m_stack[(top - i) & (STACK_SIZE - 1)] = value & 0xff;
+		value >>= 8;
+	}
+}
+
+
+//-------------------------------------------------
+//  get_float - convert an Am9511 float on the
+//  stack to a double
+//-------------------------------------------------
+
+double kim1_apu_device::get_float(int index) const
+{
+	uint32_t value = get(4, index);
+	uint32_t mantissa = value & 0xffffff;
+
+	if (!(mantissa & 0x800000))
+		return 0.0;
+
+	int exponent = sign_extend((value >> 24) & 0x7f, 7);
+	double result = ldexp(double(mantissa), exponent - 24);
+	return (value & 0x80000000) ? -result : result;
+}
+
+
+//-------------------------------------------------
+//  put_float - round a double to an Am9511 float
+//  and set the status from it
+//-------------------------------------------------
+
+void kim1_apu_device::put_float(int index, double value)
+{
+	uint32_t result = 0;
+
+	if (std::isnan(value) || std::isinf(value))
+	{
+		m_status |= STATUS_OVERFLOW;
+		value = 0.0;
+	}
+
+	if (value != 0.0)
+	{
+		int exponent;
+		double fraction = frexp(fabs(value), &exponent);
+		uint32_t mantissa = uint32_t(fraction * 16777216.0 + 0.5);
+
+		if (mantissa > 0xffffff)
+		{
+			mantissa >>= 1;
+			exponent++;
+		}
+
+		if (exponent > 63)
+			m_status |= STATUS_OVERFLOW;
+		else if (exponent < -64)
+			m_status |= STATUS_UNDERFLOW;
+		else
+			result = ((value < 0.0) ? 0x80000000 : 0) | ((exponent & 0x7f) << 24) | mantissa;
+	}
+
+	put(4, index, result);
+
+	if (result == 0)
+		m_status |= STATUS_ZERO;
+	if (result & 0x80000000)
+		m_status |= STATUS_SIGN;
+}
+
+
+//-------------------------------------------------
+//  fixed_result - store an integer result on TOS
+//  and set the status from it
+//-------------------------------------------------
+
+void kim1_apu_device::fixed_result(int size, int64_t value)
+{
+	int shift = size * 8;
+	int64_t min = -(int64_t(1) << (shift - 1));
+	int64_t max = (int64_t(1) << (shift - 1)) - 1;
+
+	if (value < min || value > max)
+		m_status |= STATUS_OVERFLOW;
+
+	uint32_t result = uint32_t(value) & uint32_t((uint64_t(1) << shift) - 1);
+	put(size, 0, result);
+
+	if (result == 0)
+		m_status |= STATUS_ZERO;
+	if (result & (1U << (shift - 1)))
+		m_status |= STATUS_SIGN;
+}
+
+
+//-------------------------------------------------
+//  execute - carry out a command, returning its
+//  execution time in clocks
+//-------------------------------------------------
+
+int kim1_apu_device::execute(uint8_t command)
+{
+	m_status = 0;
+
+	switch (command)
+	{
+	case CMD_NOP:
+		return 4;
+
+	// 16- and 32-bit integer arithmetic
+	case CMD_SADD:
+	case CMD_SSUB:
+	case CMD_SMUL:
+	case CMD_SMUU:
+	case CMD_SDIV:
+	case CMD_DADD:
+	case CMD_DSUB:
+	case CMD_DMUL:
+	case CMD_DMUU:
+	case CMD_DDIV:
+	{
+		bool wide = command < 0x40;
+		int size = wide ? 4 : 2;
+		uint32_t mask = wide ? 0xffffffff : 0xffff;
+		int64_t tos = sign_extend(get(size, 0), size * 8);
+		int64_t nos = sign_extend(get(size, 1), size * 8);
+
+		switch (command & 0x0f)
+		{
+		case CMD_DADD & 0x0f:
+			pop(size);
+			if (uint64_t(nos & mask) + uint64_t(tos & mask) > mask)
+				m_status |= STATUS_CARRY;
+			fixed_result(size, nos + tos);
+			return wide ? 21 : 17;
+
+		case CMD_DSUB & 0x0f:
+			pop(size);
+			if (uint64_t(nos & mask) < uint64_t(tos & mask))
+				m_status |= STATUS_CARRY;
+			fixed_result(size, nos - tos);
+			return wide ? 39 : 31;
+
+		case CMD_DMUL & 0x0f:
+		{
+			/* the lower half of the product, which may overflow */
+			pop(size);
+			int64_t product = nos * tos;
+			fixed_result(size, product);
+			return wide ? 200 : 89;
+		}
+
+		case CMD_DMUU & 0x0f:
+			/* the upper half of the product never overflows */
+			pop(size);
+			fixed_result(size, (nos * tos) >> (size * 8));
+			return wide ? 232 : 87;
+
+		case CMD_DDIV & 0x0f:
+			if (tos == 0)
+			{
+				pop(size);
+				m_status |= STATUS_DIVIDE_ZERO;
+				return wide ? 39 : 14;
+			}
+			pop(size);
+			fixed_result(size, nos / tos);
+			return wide ? 204 : 89;
+		}
+		return 89;
+	}
+
+	// 32-bit floating point arithmetic
+	case CMD_FADD:
+	case CMD_FSUB:
+	case CMD_FMUL:
+	case CMD_FDIV:
+	{
+		double tos = get_float(0);
+		double nos = get_float(1);
+
+		pop(4);
+		switch (command)
+		{
+		case CMD_FADD:
+			put_float(0, nos + tos);
+			return 200;
+
+		case CMD_FSUB:
+			put_float(0, nos - tos);
+			return 200;
+
+		case CMD_FMUL:
+			put_float(0, nos * tos);
+			return 168;
+
+		case CMD_FDIV:
+			if (tos == 0.0)
+			{
+				put_float(0, nos);
+				m_status |= STATUS_DIVIDE_ZERO;
+				return 22;
+			}
+			put_float(0, nos / tos);
+			return 171;
+		}
+		return 200;
+	}
+
+	// derived functions
+	case CMD_SQRT:
+	case CMD_LOG:
+	case CMD_LN:
+	{
+		double tos = get_float(0);
+
+		if (tos < 0.0 || (tos == 0.0 && command != CMD_SQRT))
+		{
+			m_status |= STATUS_NEGATIVE_ARG;
+			return 20;
+		}
+
+		switch (command)
+		{
+		case CMD_SQRT: put_float(0, sqrt(tos)); return 800;
+		case CMD_LOG: put_float(0, log10(tos)); return 4800;
+		case CMD_LN: put_float(0, log(tos)); return 4700;
+		}
+		return 800;
+	}
+
+	case CMD_SIN: put_float(0, sin(get_float(0))); return 4400;
+	case CMD_COS: put_float(0, cos(get_float(0))); return 4200;
+	case CMD_TAN: put_float(0, tan(get_float(0))); return 5300;
+	case CMD_ATAN: put_float(0, atan(get_float(0))); return 6000;
+
+	case CMD_ASIN:
+	case CMD_ACOS:
+	{
+		double tos = get_float(0);
+
+		if (fabs(tos) > 1.0)
+		{
+			m_status |= STATUS_ARG_RANGE;
+			return 20;
+		}
+
+		put_float(0, (command == CMD_ASIN) ? asin(tos) : acos(tos));
+		return (command == CMD_ASIN) ? 7600 : 7700;
+	}
+
+	case CMD_EXP:
+	{
+		double tos = get_float(0);
+
+		/* the largest result is about 2^63 */
+		if (fabs(tos) > 43.67)
+		{
+			m_status |= STATUS_ARG_RANGE;
+			return 20;
+		}
+
+		put_float(0, exp(tos));
+		return 4500;
+	}
+
+	case CMD_PWR:
+	{
+		double tos = get_float(0);
+		double nos = get_float(1);
+
+		if (nos <= 0.0)
+		{
+			m_status |= STATUS_NEGATIVE_ARG;
+			return 20;
+		}
+
+		pop(4);
+		put_float(0, pow(nos, tos));
+		return 10000;
+	}
+
+	// conversions
+	case CMD_FIXS:
+	case CMD_FIXD:
+	{
+		int size = (command == CMD_FIXS) ? 2 : 4;
+		double tos = get_float(0);
+		int64_t max = (int64_t(1) << (size * 8 - 1)) - 1;
+
+		if (tos > double(max) || tos < -double(max + 1))
+		{
+			m_status |= STATUS_ARG_RANGE;
+			return 20;
+		}
+
+		pop(4);
+		push(size, 0);
+		fixed_result(size, int64_t(tos));
+		return (size == 2) ? 150 : 200;
+	}
+
+	case CMD_FLTS:
+	case CMD_FLTD:
+	{
+		int size = (command == CMD_FLTS) ? 2 : 4;
+		double value = double(sign_extend(get(size, 0), size * 8));
+
+		pop(size);
+		push(4, 0);
+		put_float(0, value);
+		return (size == 2) ? 100 : 60;
+	}
+
+	// stack manipulation
+	case CMD_CHSS:
+		fixed_result(2, -int64_t(sign_extend(get(2, 0), 16)));
+		return 23;
+
+	case CMD_CHSD:
+		fixed_result(4, -int64_t(sign_extend(get(4, 0), 32)));
+		return 27;
+
+	case CMD_CHSF:
+		put_float(0, -get_float(0));
+		return 18;
+
+	case CMD_PTOS:
+	case CMD_PTOD:
+	case CMD_PTOF:
+	{
+		int size = (command == CMD_PTOS) ? 2 : 4;
+		push(size, get(size, 0));
+		return (size == 2) ? 16 : 20;
+	}
+
+	case CMD_POPS:
+	case CMD_POPD:
+	case CMD_POPF:
+	{
+		int size = (command == CMD_POPS) ? 2 : 4;
+		pop(size);
+		return (size == 2) ? 10 : 12;
+	}
+
+	case CMD_XCHS:
+	case CMD_XCHD:
+	case CMD_XCHF:
+	{
+		int size = (command == CMD_XCHS) ? 2 : 4;
+		uint32_t tos = get(size, 0);
+		put(size, 0, get(size, 1));
+		put(size, 1, tos);
+		return (size == 2) ? 18 : 26;
+	}
+
+	case CMD_PUPI:
+		push(4, 0);
+		put_float(0, M_PI);
+		return 16;
+	}
+
+	logerror("unknown command %02x\n", command);
+	return 4;
+}
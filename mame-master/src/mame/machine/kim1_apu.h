@@ -0,0 +1,78 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 arithmetic processor card
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_APU_H
+#define MAME_MACHINE_KIM1_APU_H
+
+#pragma once
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+class kim1_apu_device : public device_t
+{
+public:
+	// construction/destruction
+	kim1_apu_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock);
+
+	void set_instant(bool instant) { m_instant = instant; }
+
+	DECLARE_READ8_MEMBER( read );
+	DECLARE_WRITE8_MEMBER( write );
+
+protected:
+	// device-level overrides
+	virtual void device_start() override;
+	virtual void device_reset() override;
+
+private:
+	enum
+	{
+		STACK_SIZE = 16
+	};
+
+	enum
+	{
+		STATUS_CARRY = 0x01,
+		STATUS_OVERFLOW = 0x02,
+		STATUS_UNDERFLOW = 0x04,
+		STATUS_NEGATIVE_ARG = 0x08,
+		STATUS_DIVIDE_ZERO = 0x10,
+		STATUS_ARG_RANGE = 0x18,
+		STATUS_ZERO = 0x20,
+		STATUS_SIGN = 0x40,
+		STATUS_BUSY = 0x80
+	};
+
+	uint8_t pop_byte();
+	void push_byte(uint8_t data);
+	uint32_t get(int size, int index) const;
+	void put(int size, int index, uint32_t value);
+	void pop(int size) { m_sp = (m_sp - size) & (STACK_SIZE - 1); }
+	void push(int size, uint32_t value) { m_sp = (m_sp + size) & (STACK_SIZE - 1); put(size, 0, value); }
+
+	double get_float(int index) const;
+	void put_float(int index, double value);
+	void fixed_result(int size, int64_t value);
+
+	int execute(uint8_t command);
+
+	bool m_instant;
+	uint8_t m_stack[STACK_SIZE];
+	uint8_t m_sp;
+	uint8_t m_status;
+	attotime m_busy_until;
+};
+
+
+// device type definition
+DECLARE_DEVICE_TYPE(KIM1_APU, kim1_apu_device)
+
+#endif // MAME_MACHINE_KIM1_APU_H
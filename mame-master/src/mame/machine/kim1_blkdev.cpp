@@ -0,0 +1,245 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 block storage card
+
+    A simple block device for fast program and data loading. The image
+    is a flat file of 256-byte sectors; whole sectors are moved
+    between the image and KIM-1 memory by DMA, and complete before the
+    command write returns.
+
+    Registers:
+        0   W: command (01 = read, 02 = write), R: status
+            (bit 0 = media present, bit 6 = error in last command)
+        1-3 sector number, low byte first
+        4-5 DMA address, low byte first
+        6   sector count (0 = 256)
+    After a command, the sector number and DMA address point past the
+    last sector moved.
+
+    Reading sectors from the host goes through a small direct-mapped
+    cache; writes go through to the image.
+
+    Loading a program, with the registers at E010:
+
+        LDA #$00        ; sector 0
+        STA $E011
+        STA $E012
+        STA $E013
+        STA $E014       ; to $2000
+        LDA #$20
+        STA $E015
+        LDA #$10        ; 16 sectors = 4 KB
+        STA $E016
+        LDA #$01        ; read
+        STA $E010
+        LDA $E010
+        AND #$40
+        BNE ERROR
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_blkdev.h"
+
+
+//**************************************************************************
+//  DEVICE DEFINITIONS
+//**************************************************************************
+
+DEFINE_DEVICE_TYPE(KIM1_BLKDEV, kim1_blkdev_device, "kim1_blkdev", "KIM-1 Block Storage Card")
+
+
+//**************************************************************************
+//  LIVE DEVICE
+//**************************************************************************
+
+//-------------------------------------------------
+//  kim1_blkdev_device - constructor
+//-------------------------------------------------
+
+kim1_blkdev_device::kim1_blkdev_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock)
+	: device_t(mconfig, KIM1_BLKDEV, tag, owner, clock),
+	device_image_interface(mconfig, *this),
+	m_status(0),
+	m_sector(0),
+	m_address(0),
+	m_count(0),
+	m_sectors(0)
+{
+}
+
+
+//-------------------------------------------------
+//  device_start - device-specific startup
+//-------------------------------------------------
+
+void kim1_blkdev_device::device_start()
+{
+	for (auto &line : m_cache)
+		line.valid = false;
+
+	save_item(NAME(m_status));
+	save_item(NAME(m_sector));
+	save_item(NAME(m_address));
+	save_item(NAME(m_count));
+}
+
+
+//-------------------------------------------------
+//  device_reset - device-specific reset
+//-------------------------------------------------
+
+void kim1_blkdev_device::device_reset()
+{
+	m_status &= ~STATUS_ERROR;
+}
+
+
+//-------------------------------------------------
+//  call_load - an image was mounted
+//-------------------------------------------------
+
+image_init_result kim1_blkdev_device::call_load()
+{
+	m_sectors = length() / SECTOR_SIZE;
+	if (m_sectors == 0)
+		return image_init_result::FAIL;
+
+	for (auto &line : m_cache)
+		line.valid = false;
+
+	m_status |= STATUS_MEDIA;
+	return image_init_result::PASS;
+}
+
+
+//-------------------------------------------------
+//  call_unload - the image was removed
+//-------------------------------------------------
+
+void kim1_blkdev_device::call_unload()
+{
+	m_sectors = 0;
+	m_status &= ~STATUS_MEDIA;
+}
+
+
+//-------------------------------------------------
+//  read -
+//-------------------------------------------------
+
+READ8_MEMBER( kim1_blkdev_device::read )
+{
+	switch (offset & 0x0f)
+	{
+	case 0: return m_status;
+	case 1: return m_sector & 0xff;
+	case 2: return (m_sector >> 8) & 0xff;
+	case 3: return (m_sector >> 16) & 0xff;
+	case 4: return m_address & 0xff;
+	case 5: return m_address >> 8;
+	case 6: return m_count;
+	}
+
+	return 0xff;
+}
+
+
+//-------------------------------------------------
+//  write -
+//-------------------------------------------------
+
+WRITE8_MEMBER( kim1_blkdev_device::write )
+{
+	switch (offset & 0x0f)
+	{
+	case 0: execute(space, data); break;
+	case 1: m_sector = (m_sector & 0xffff00) | data; break;
+	case 2: m_sector = (m_sector & 0xff00ff) | (data << 8); break;
+	case 3: m_sector = (m_sector & 0x00ffff) | (data << 16); break;
+	case 4: m_address = (m_address & 0xff00) | data; break;
+	case 5: m_address = (m_address & 0x00ff) | (data << 8); break;
+	case 6: m_count = data; break;
+	}
+}
+
+
+//-------------------------------------------------
+//  fetch - find a sector in the cache, reading
+//  it from the image on a miss
+//-------------------------------------------------
+
+kim1_blkdev_device::cache_line *kim1_blkdev_device::fetch(uint32_t sector)
+{
+	cache_line &line = m_cache[sector % CACHE_SECTORS];
+
+	if (!line.valid || line.sector != sector)
+	{
+		fseek(uint64_t(sector) * SECTOR_SIZE, SEEK_SET);
+		if (fread(line.data, SECTOR_SIZE) != SECTOR_SIZE)
+		{
+			line.valid = false;
+			return nullptr;
+		}
+		line.sector = sector;
+		line.valid = true;
+	}
+
+	return &line;
+}
+
+
+//-------------------------------------------------
+//  execute - carry out a command
+//-------------------------------------------------
+
+void kim1_blkdev_device::execute(address_space &space, uint8_t command)
+{
+	int count = m_count ? m_count : 256;
+
+	m_status &= ~STATUS_ERROR;
+
+	if (!exists() || (command != CMD_READ && command != CMD_WRITE) || m_sector + count > m_sectors)
+	{
+		m_status |= STATUS_ERROR;
+		return;
+	}
+
+	while (count--)
+	{
+		if (command == CMD_READ)
+		{
+			cache_line *line = fetch(m_sector);
+			if (line == nullptr)
+			{
+				m_status |= STATUS_ERROR;
+				return;
+			}
+
+			for (int i = 0; i < SECTOR_SIZE; i++)
+				space.write_byte((m_address + i) & 0xffff, line->data[i]);
+		}
+		else
+		{
+			cache_line &line = m_cache[m_sector % CACHE_SECTORS];
+
+			for (int i = 0; i < SECTOR_SIZE; i++)
+				line.data[i] = space.read_byte((m_address + i) & 0xffff);
+			line.sector = m_sector;
+			line.valid = true;
+
+			fseek(uint64_t(m_sector) * SECTOR_SIZE, SEEK_SET);
+			if (fwrite(line.data, SECTOR_SIZE) != SECTOR_SIZE)
+			{
+				line.valid = false;
+				m_status |= STATUS_ERROR;
+				return;
+			}
+		}
+
+		m_sector++;
+		m_address += SECTOR_SIZE;
+	}
+}
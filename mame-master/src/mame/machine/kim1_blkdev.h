@@ -0,0 +1,87 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 block storage card
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_BLKDEV_H
+#define MAME_MACHINE_KIM1_BLKDEV_H
+
+#pragma once
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+class kim1_blkdev_device : public device_t,
+							public device_image_interface
+{
+public:
+	// construction/destruction
+	kim1_blkdev_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock);
+
+	// image-level overrides
+	virtual iodevice_t image_type() const override { return IO_HARDDISK; }
+	virtual bool is_readable()  const override { return true; }
+	virtual bool is_writeable() const override { return true; }
+	virtual bool is_creatable() const override { return false; }
+	virtual bool must_be_loaded() const override { return false; }
+	virtual bool is_reset_on_load() const override { return false; }
+	virtual const char *file_extensions() const override { return "img,bin"; }
+	virtual image_init_result call_load() override;
+	virtual void call_unload() override;
+
+	DECLARE_READ8_MEMBER( read );
+	DECLARE_WRITE8_MEMBER( write );
+
+protected:
+	// device-level overrides
+	virtual void device_start() override;
+	virtual void device_reset() override;
+
+private:
+	enum
+	{
+		SECTOR_SIZE = 256,
+		CACHE_SECTORS = 8
+	};
+
+	enum
+	{
+		CMD_READ = 0x01,
+		CMD_WRITE = 0x02
+	};
+
+	enum
+	{
+		STATUS_MEDIA = 0x01,
+		STATUS_ERROR = 0x40
+	};
+
+	struct cache_line
+	{
+		uint32_t sector;
+		bool valid;
+		uint8_t data[SECTOR_SIZE];
+	};
+
+	void execute(address_space &space, uint8_t command);
+	cache_line *fetch(uint32_t sector);
+
+	uint8_t m_status;
+	uint32_t m_sector;
+	uint16_t m_address;
+	uint8_t m_count;
+	uint32_t m_sectors;
+
+	cache_line m_cache[CACHE_SECTORS];
+};
+
+
+// device type definition
+DECLARE_DEVICE_TYPE(KIM1_BLKDEV, kim1_blkdev_device)
+
+#endif // MAME_MACHINE_KIM1_BLKDEV_H
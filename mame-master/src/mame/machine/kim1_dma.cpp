@@ -0,0 +1,229 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 DMA controller card
+
+    Copies blocks of KIM-1 memory natively, for the block moves that
+    cost a 6502 about 14 cycles a byte. The copy goes through the CPU's
+    address space, so it works between any of RAM, the video window
+    (whose write handler marks the rows changed) and banked memory.
+    Overlapping blocks are copied as by memmove.
+
+    Registers:
+        0-1 source address, low byte first
+        2-3 destination address, low byte first
+        4-5 length in bytes (0 = 65536)
+        6   W: control (bit 0 = start, bit 1 = interrupt on completion)
+            R: status (bit 7 = done); reading clears the interrupt
+        7   CPU cycles per byte the CPU is held for; 0 = turbo, the copy
+            costs the CPU nothing
+
+    The copy happens when the start bit is written, and the CPU is held
+    for the programmed number of cycles per byte, as it would be on a
+    bus shared with real DMA.
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_dma.h"
+
+
+//**************************************************************************
+//  DEVICE DEFINITIONS
+//**************************************************************************
+
+DEFINE_DEVICE_TYPE(KIM1_DMA, kim1_dma_device, "kim1_dma", "KIM-1 DMA Controller Card")
+
+
+//**************************************************************************
+//  LIVE DEVICE
+//**************************************************************************
+
+//-------------------------------------------------
+//  kim1_dma_device - constructor
+//-------------------------------------------------
+
+kim1_dma_device::kim1_dma_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock)
+	: device_t(mconfig, KIM1_DMA, tag, owner, clock),
+	m_irq_handler(*this),
+	m_source(0),
+	m_dest(0),
+	m_length(0),
+	m_control(0),
+	m_status(0),
+	m_cycles_per_byte(1)
+{
+}
+
+
+//-------------------------------------------------
+//  device_start - device-specific startup
+//-------------------------------------------------
+
+void kim1_dma_device::device_start()
+{
+	m_irq_handler.resolve_safe();
+
+	save_item(NAME(m_source));
+	save_item(NAME(m_dest));
+	save_item(NAME(m_length));
+	save_item(NAME(m_control));
+	save_item(NAME(m_status));
+	save_item(NAME(m_cycles_per_byte));
+}
+
+
+//-------------------------------------------------
+//  device_reset - device-specific reset
+//-------------------------------------------------
+
+void kim1_dma_device::device_reset()
+{
+	m_control = 0;
+	m_status = 0;
+	m_cycles_per_byte = 1;
+	m_irq_handler(CLEAR_LINE);
+}
+
+
+//-------------------------------------------------
+//  read -
+//-------------------------------------------------
+
+READ8_MEMBER( kim1_dma_device::read )
+{
+	switch (offset & 0x07)
+	{
+	case 0: return m_source & 0xff;
+	case 1: return m_source >> 8;
+	case 2: return m_dest & 0xff;
+	case 3: return m_dest >> 8;
+	case 4: return m_length & 0xff;
+	case 5: return m_length >> 8;
+	case 6:
+	{
+		uint8_t data = m_status;
+		if (!machine().side_effect_disabled() && (m_status & STATUS_DONE))
+		{
+			m_status &= ~STATUS_DONE;
+			m_irq_handler(CLEAR_LINE);
+		}
+		return data;
+	}
+	case 7: return m_cycles_per_byte;
+	}
+
+	return 0xff;
+}
+
+
+//-------------------------------------------------
+//  write -
+//-------------------------------------------------
+
+WRITE8_MEMBER( kim1_dma_device::write )
+{
+	switch (offset & 0x07)
+	{
+	case 0: m_source = (m_source & 0xff00) | data; break;
+	case 1: m_source = (m_source & 0x00ff) | (data << 8); break;
+	case 2: m_dest = (m_dest & 0xff00) | data; break;
+	case 3: m_dest = (m_dest & 0x00ff) | (data << 8); break;
+	case 4: m_length = (m_length & 0xff00) | data; break;
+	case 5: m_length = (m_length & 0x00ff) | (data << 8); break;
+	case 6:
+		m_control = data;
+		if (data & CONTROL_START)
+			transfer(space);
+		break;
+	case 7: m_cycles_per_byte = data; break;
+	}
+}
+
+
+//-------------------------------------------------
+//  copy_span - copy between addresses that do not
+//  wrap, a page at a time; pages that are plain
+//  memory on both sides are moved with memmove
+//-------------------------------------------------
+
+void kim1_dma_device::copy_span(address_space &space, offs_t src, offs_t dst, uint32_t length, bool backwards)
+{
+	while (length != 0)
+	{
+		/* the chunk ends at the nearer page boundary of either side */
+		uint32_t chunk;
+		offs_t s, d;
+
+		if (backwards)
+		{
+			chunk = std::min<uint32_t>({ length, ((src + length - 1) & 0xff) + 1, ((dst + length - 1) & 0xff) + 1 });
+			s = src + length - chunk;
+			d = dst + length - chunk;
+		}
+		else
+		{
+			chunk = std::min<uint32_t>({ length, 0x100 - (src & 0xff), 0x100 - (dst & 0xff) });
+			s = src;
+			d = dst;
+		}
+
+		const uint8_t *sptr = reinterpret_cast<const uint8_t *>(space.get_read_ptr(s));
+		uint8_t *dptr = reinterpret_cast<uint8_t *>(space.get_write_ptr(d));
+
+		if (sptr != nullptr && dptr != nullptr)
+			memmove(dptr, sptr, chunk);
+		else if (backwards)
+		{
+			for (int i = chunk - 1; i >= 0; i--)
+				space.write_byte(d + i, space.read_byte(s + i));
+		}
+		else
+		{
+			for (int i = 0; i < chunk; i++)
+				space.write_byte(d + i, space.read_byte(s + i));
+		}
+
+		if (!backwards)
+		{
+			src += chunk;
+			dst += chunk;
+		}
+		length -= chunk;
+	}
+}
+
+
+//-------------------------------------------------
+//  transfer - carry out the programmed copy
+//-------------------------------------------------
+
+void kim1_dma_device::transfer(address_space &space)
+{
+	uint32_t length = m_length ? m_length : 0x10000;
+
+	/* copy from the top down when the destination overlaps the end of
+	   the source */
+	bool backwards = m_dest > m_source && m_dest < m_source + length;
+
+	if (m_source + length <= 0x10000 && m_dest + length <= 0x10000)
+		copy_span(space, m_source, m_dest, length, backwards);
+	else
+	{
+		/* wrapping blocks go a byte at a time */
+		for (uint32_t i = 0; i < length; i++)
+		{
+			uint32_t n = backwards ? length - 1 - i : i;
+			space.write_byte((m_dest + n) & 0xffff, space.read_byte((m_source + n) & 0xffff));
+		}
+	}
+
+	/* hold the CPU for the length of the transfer */
+	if (m_cycles_per_byte != 0)
+		space.device().execute().adjust_icount(-int(length * m_cycles_per_byte));
+
+	m_status |= STATUS_DONE;
+	if (m_control & CONTROL_IRQ_ENABLE)
+		m_irq_handler(ASSERT_LINE);
+}
@@ -0,0 +1,72 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 DMA controller card
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_DMA_H
+#define MAME_MACHINE_KIM1_DMA_H
+
+#pragma once
+
+
+//**************************************************************************
+//  INTERFACE CONFIGURATION MACROS
+//**************************************************************************
+
+#define MCFG_KIM1_DMA_IRQ_HANDLER(_devcb) \
+	devcb = &kim1_dma_device::set_irq_handler(*device, DEVCB_##_devcb);
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+class kim1_dma_device : public device_t
+{
+public:
+	// construction/destruction
+	kim1_dma_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock);
+
+	template <class Object> static devcb_base &set_irq_handler(device_t &device, Object &&cb) { return downcast<kim1_dma_device &>(device).m_irq_handler.set_callback(std::forward<Object>(cb)); }
+
+	DECLARE_READ8_MEMBER( read );
+	DECLARE_WRITE8_MEMBER( write );
+
+protected:
+	// device-level overrides
+	virtual void device_start() override;
+	virtual void device_reset() override;
+
+private:
+	enum
+	{
+		CONTROL_START = 0x01,
+		CONTROL_IRQ_ENABLE = 0x02
+	};
+
+	enum
+	{
+		STATUS_DONE = 0x80
+	};
+
+	void transfer(address_space &space);
+	void copy_span(address_space &space, offs_t src, offs_t dst, uint32_t length, bool backwards);
+
+	devcb_write_line m_irq_handler;
+
+	uint16_t m_source;
+	uint16_t m_dest;
+	uint16_t m_length;
+	uint8_t m_control;
+	uint8_t m_status;
+	uint8_t m_cycles_per_byte;
+};
+
+
+// device type definition
+DECLARE_DEVICE_TYPE(KIM1_DMA, kim1_dma_device)
+
+#endif // MAME_MACHINE_KIM1_DMA_H
@@ -0,0 +1,222 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 host-call port
+
+    A paravirtual device for test programs: guest code can print to the
+    host's stdout, end the run with a status, read test vectors from
+    host files and read the CPU cycle count.
+
+    Registers:
+        0   W: command, R: status of the last command (0 = ok, 80 = error)
+        1   argument byte
+        2-3 pointer into KIM-1 memory, low byte first
+        4-5 length; after READ, the number of bytes read
+        8-B cycle count latched by CYCLES, low byte first
+
+    Files are opened read-only, by name, from the host's kim1_host
+    directory, with names checked by the same rule as the host
+    directory bridge. EXIT prints its status on the console before the
+    run stops.
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_hostcall.h"
+#include "kim1_hostfs.h"
+
+
+//**************************************************************************
+//  DEVICE DEFINITIONS
+//**************************************************************************
+
+DEFINE_DEVICE_TYPE(KIM1_HOSTCALL, kim1_hostcall_device, "kim1_hostcall", "KIM-1 Host-Call Port")
+
+
+//**************************************************************************
+//  LIVE DEVICE
+//**************************************************************************
+
+//-------------------------------------------------
+//  kim1_hostcall_device - constructor
+//-------------------------------------------------
+
+kim1_hostcall_device::kim1_hostcall_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock)
+	: device_t(mconfig, KIM1_HOSTCALL, tag, owner, clock),
+	m_directory("kim1_host"),
+	m_status(STATUS_OK),
+	m_pointer(0),
+	m_length(0),
+	m_argument(0),
+	m_cycles(0),
+	m_exited(false),
+	m_exit_status(0)
+{
+}
+
+
+//-------------------------------------------------
+//  device_start - device-specific startup
+//-------------------------------------------------
+
+void kim1_hostcall_device::device_start()
+{
+	save_item(NAME(m_status));
+	save_item(NAME(m_pointer));
+	save_item(NAME(m_length));
+	save_item(NAME(m_argument));
+	save_item(NAME(m_cycles));
+}
+
+
+//-------------------------------------------------
+//  device_reset - device-specific reset
+//-------------------------------------------------
+
+void kim1_hostcall_device::device_reset()
+{
+	m_file.reset();
+	m_status = STATUS_OK;
+}
+
+
+//-------------------------------------------------
+//  read -
+//-------------------------------------------------
+
+READ8_MEMBER( kim1_hostcall_device::read )
+{
+	switch (offset & 0x0f)
+	{
+	case 0: return m_status;
+	case 1: return m_argument;
+	case 2: return m_pointer & 0xff;
+	case 3: return m_pointer >> 8;
+	case 4: return m_length & 0xff;
+	case 5: return m_length >> 8;
+	case 8: case 9: case 10: case 11:
+		return m_cycles >> ((offset & 3) * 8);
+	}
+
+	return 0xff;
+}
+
+
+//-------------------------------------------------
+//  write -
+//-------------------------------------------------
+
+WRITE8_MEMBER( kim1_hostcall_device::write )
+{
+	switch (offset & 0x0f)
+	{
+	case 0: execute(space, data); break;
+	case 1: m_argument = data; break;
+	case 2: m_pointer = (m_pointer & 0xff00) | data; break;
+	case 3: m_pointer = (m_pointer & 0x00ff) | (data << 8); break;
+	case 4: m_length = (m_length & 0xff00) | data; break;
+	case 5: m_length = (m_length & 0x00ff) | (data << 8); break;
+	}
+}
+
+
+//-------------------------------------------------
+//  read_string - fetch a zero-terminated string
+//  from KIM-1 memory
+//-------------------------------------------------
+
+std::string kim1_hostcall_device::read_string(address_space &space, offs_t address)
+{
+	std::string result;
+
+	for (int i = 0; i < 256; i++)
+	{
+		uint8_t data = space.read_byte((address + i) & 0xffff);
+		if (data == 0)
+			break;
+		result.push_back(char(data));
+	}
+
+	return result;
+}
+
+
+//-------------------------------------------------
+//  execute - carry out a command
+//-------------------------------------------------
+
+void kim1_hostcall_device::execute(address_space &space, uint8_t command)
+{
+	m_status = STATUS_OK;
+
+	switch (command)
+	{
+	case CMD_PUTC:
+		putchar(m_argument);
+		fflush(stdout);
+		break;
+
+	case CMD_PUTS:
+		fputs(read_string(space, m_pointer).c_str(), stdout);
+		fflush(stdout);
+		break;
+
+	case CMD_EXIT:
+		m_exited = true;
+		m_exit_status = m_argument;
+		osd_printf_info("KIM-1 program exited with status %d\n", m_exit_status);
+		machine().schedule_exit();
+		break;
+
+	case CMD_OPEN:
+	{
+		std::string name = read_string(space, m_pointer);
+
+		m_file.reset();
+		if (!kim1_hostfs_device::valid_name(name))
+		{
+			m_status = STATUS_ERROR;
+			break;
+		}
+
+		m_file = std::make_unique<emu_file>(m_directory, OPEN_FLAG_READ);
+		if (m_file->open(name.c_str()) != osd_file::error::NONE)
+		{
+			m_file.reset();
+			m_status = STATUS_ERROR;
+		}
+		break;
+	}
+
+	case CMD_READ:
+	{
+		if (!m_file)
+		{
+			m_status = STATUS_ERROR;
+			break;
+		}
+		if (m_length == 0)
+			break;
+
+		std::vector<uint8_t> buffer(m_length);
+		m_length = m_file->read(&buffer[0], buffer.size());
+		for (int i = 0; i < m_length; i++)
+			space.write_byte((m_pointer + i) & 0xffff, buffer[i]);
+		break;
+	}
+
+	case CMD_CLOSE:
+		m_file.reset();
+		break;
+
+	case CMD_CYCLES:
+		m_cycles = space.device().execute().total_cycles();
+		break;
+
+	default:
+		logerror("unknown command %02X\n", command);
+		m_status = STATUS_ERROR;
+		break;
+	}
+}
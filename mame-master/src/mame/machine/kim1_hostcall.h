@@ -0,0 +1,74 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 host-call port
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_HOSTCALL_H
+#define MAME_MACHINE_KIM1_HOSTCALL_H
+
+#pragma once
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+class kim1_hostcall_device : public device_t
+{
+public:
+	// construction/destruction
+	kim1_hostcall_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock);
+
+	DECLARE_READ8_MEMBER( read );
+	DECLARE_WRITE8_MEMBER( write );
+
+	bool exited() const { return m_exited; }
+	int exit_status() const { return m_exit_status; }
+
+protected:
+	// device-level overrides
+	virtual void device_start() override;
+	virtual void device_reset() override;
+
+private:
+	enum
+	{
+		CMD_PUTC = 0x01,    // print the argument byte
+		CMD_PUTS = 0x02,    // print the string at the pointer
+		CMD_EXIT = 0x03,    // stop emulation, argument is the status
+		CMD_OPEN = 0x04,    // open the file named at the pointer
+		CMD_READ = 0x05,    // read up to length bytes to the pointer
+		CMD_CLOSE = 0x06,   // close the open file
+		CMD_CYCLES = 0x07   // latch the CPU cycle count
+	};
+
+	enum
+	{
+		STATUS_OK = 0x00,
+		STATUS_ERROR = 0x80
+	};
+
+	void execute(address_space &space, uint8_t command);
+	std::string read_string(address_space &space, offs_t address);
+
+	const char *m_directory;
+	std::unique_ptr<emu_file> m_file;
+
+	uint8_t m_status;
+	uint16_t m_pointer;
+	uint16_t m_length;
+	uint8_t m_argument;
+	uint32_t m_cycles;
+
+	bool m_exited;
+	int m_exit_status;
+};
+
+
+// device type definition
+DECLARE_DEVICE_TYPE(KIM1_HOSTCALL, kim1_hostcall_device)
+
+#endif // MAME_MACHINE_KIM1_HOSTCALL_H
@@ -0,0 +1,313 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 host directory bridge
+
+    Gives the KIM-1 named access to the files of the host's kim1_host
+    directory, the one the host-call port reads from, so monitor
+    extensions or KVOS can load and save programs without tape.
+    Only plain names are accepted (letters, digits, '.', '-' and '_',
+    not starting with '.'), so the guest cannot leave the directory;
+    the host-call port opens files by the same rule. A file written is
+    at most 64 KB.
+
+    Registers:
+        0   W: command, R: status of the last command (0 = ok, 80 = error)
+        2-3 pointer into KIM-1 memory, low byte first: the file name
+            for OPEN, the buffer for READ and WRITE
+        4-5 length; after READ, the number of bytes read
+        6-8 file position, low byte first; SIZE puts the file size here
+
+    A file being read is held in memory, and its contents are cached
+    for the life of the process (not across runs), keyed by path and
+    checked against the file's size and modification time; loading the
+    same program into many runs touches the disk once. Files being
+    written are built up in memory and written out on CLOSE.
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_hostfs.h"
+
+#include <mutex>
+
+
+//**************************************************************************
+//  DEVICE DEFINITIONS
+//**************************************************************************
+
+DEFINE_DEVICE_TYPE(KIM1_HOSTFS, kim1_hostfs_device, "kim1_hostfs", "KIM-1 Host Directory Bridge")
+
+
+//**************************************************************************
+//  FILE CONTENTS CACHE
+//**************************************************************************
+
+namespace {
+
+struct cached_file
+{
+	uint64_t size;
+	std::chrono::system_clock::time_point modified;
+	std::shared_ptr<const std::vector<uint8_t>> contents;
+};
+
+std::mutex s_cache_lock;
+std::unordered_map<std::string, cached_file> s_cache;
+
+} // anonymous namespace
+
+
+//**************************************************************************
+//  LIVE DEVICE
+//**************************************************************************
+
+//-------------------------------------------------
+//  kim1_hostfs_device - constructor
+//-------------------------------------------------
+
+kim1_hostfs_device::kim1_hostfs_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock)
+	: device_t(mconfig, KIM1_HOSTFS, tag, owner, clock),
+	m_directory("kim1_host"),
+	m_status(STATUS_OK),
+	m_pointer(0),
+	m_length(0),
+	m_position(0),
+	m_writing(false)
+{
+}
+
+
+//-------------------------------------------------
+//  device_start - device-specific startup
+//-------------------------------------------------
+
+void kim1_hostfs_device::device_start()
+{
+	save_item(NAME(m_status));
+	save_item(NAME(m_pointer));
+	save_item(NAME(m_length));
+	save_item(NAME(m_position));
+}
+
+
+//-------------------------------------------------
+//  device_reset - device-specific reset
+//-------------------------------------------------
+
+void kim1_hostfs_device::device_reset()
+{
+	m_name.clear();
+	m_contents.reset();
+	m_output.clear();
+	m_writing = false;
+	m_status = STATUS_OK;
+}
+
+
+//-------------------------------------------------
+//  read -
+//-------------------------------------------------
+
+READ8_MEMBER( kim1_hostfs_device::read )
+{
+	switch (offset & 0x0f)
+	{
+	case 0: return m_status;
+	case 2: return m_pointer & 0xff;
+	case 3: return m_pointer >> 8;
+	case 4: return m_length & 0xff;
+	case 5: return m_length >> 8;
+	case 6: return m_position & 0xff;
+	case 7: return (m_position >> 8) & 0xff;
+	case 8: return (m_position >> 16) & 0xff;
+	}
+
+	return 0xff;
+}
+
+
+//-------------------------------------------------
+//  write -
+//-------------------------------------------------
+
+WRITE8_MEMBER( kim1_hostfs_device::write )
+{
+	switch (offset & 0x0f)
+	{
+	case 0: execute(space, data); break;
+	case 2: m_pointer = (m_pointer & 0xff00) | data; break;
+	case 3: m_pointer = (m_pointer & 0x00ff) | (data << 8); break;
+	case 4: m_length = (m_length & 0xff00) | data; break;
+	case 5: m_length = (m_length & 0x00ff) | (data << 8); break;
+	case 6: m_position = (m_position & 0xffff00) | data; break;
+	case 7: m_position = (m_position & 0xff00ff) | (data << 8); break;
+	case 8: m_position = (m_position & 0x00ffff) | (data << 16); break;
+	}
+}
+
+
+//-------------------------------------------------
+//  valid_name - check a guest file name stays
+//  inside the directory
+//-------------------------------------------------
+
+bool kim1_hostfs_device::valid_name(const std::string &name)
+{
+	if (name.empty() || name[0] == '.')
+		return false;
+
+	for (char ch : name)
+		if (!isalnum(uint8_t(ch)) && ch != '.' && ch != '-' && ch != '_')
+			return false;
+
+	return true;
+}
+
+
+//-------------------------------------------------
+//  load - get a file's contents, from the cache
+//  if the file has not changed
+//-------------------------------------------------
+
+kim1_hostfs_device::contents_ptr kim1_hostfs_device::load(const std::string &name)
+{
+	emu_file file(m_directory, OPEN_FLAG_READ);
+	if (file.open(name.c_str()) != osd_file::error::NONE)
+		return nullptr;
+
+	std::string path = file.fullpath();
+	std::unique_ptr<osd::directory::entry> entry = osd_stat(path);
+
+	if (entry)
+	{
+		std::lock_guard<std::mutex> lock(s_cache_lock);
+		auto cached = s_cache.find(path);
+		if (cached != s_cache.end() && cached->second.size == entry->size && cached->second.modified == entry->last_modified)
+			return cached->second.contents;
+	}
+
+	auto data = std::make_shared<std::vector<uint8_t>>(file.size());
+	if (!data->empty() && file.read(&(*data)[0], data->size()) != data->size())
+		return nullptr;
+
+	if (entry)
+	{
+		std::lock_guard<std::mutex> lock(s_cache_lock);
+		s_cache[path] = cached_file{ entry->size, entry->last_modified, data };
+	}
+
+	return data;
+}
+
+
+//-------------------------------------------------
+//  store - write a file out
+//-------------------------------------------------
+
+void kim1_hostfs_device::store(const std::string &name, std::vector<uint8_t> &&data)
+{
+	emu_file file(m_directory, OPEN_FLAG_WRITE | OPEN_FLAG_CREATE | OPEN_FLAG_CREATE_PATHS);
+
+	if (file.open(name.c_str()) != osd_file::error::NONE || (!data.empty() && file.write(&data[0], data.size()) != data.size()))
+		m_status = STATUS_ERROR;
+
+	/* a changed file is reloaded on its next open */
+	std::lock_guard<std::mutex> lock(s_cache_lock);
+	s_cache.erase(file.fullpath());
+}
+
+
+//-------------------------------------------------
+//  execute - carry out a command
+//-------------------------------------------------
+
+void kim1_hostfs_device::execute(address_space &space, uint8_t command)
+{
+	m_status = STATUS_OK;
+
+	switch (command)
+	{
+	case CMD_OPEN_READ:
+	case CMD_OPEN_WRITE:
+	{
+		std::string name;
+		for (int i = 0; i < 64; i++)
+		{
+			uint8_t data = space.read_byte((m_pointer + i) & 0xffff);
+			if (data == 0)
+				break;
+			name.push_back(char(data));
+		}
+
+		m_contents.reset();
+		m_output.clear();
+		m_name.clear();
+		m_position = 0;
+
+		if (!valid_name(name))
+		{
+			m_status = STATUS_ERROR;
+			break;
+		}
+
+		m_writing = (command == CMD_OPEN_WRITE);
+		if (!m_writing && !(m_contents = load(name)))
+		{
+			m_status = STATUS_ERROR;
+			break;
+		}
+		m_name = name;
+		break;
+	}
+
+	case CMD_READ:
+		if (m_name.empty() || m_writing)
+			m_status = STATUS_ERROR;
+		else
+		{
+			uint32_t size = m_contents->size();
+			uint32_t count = (m_position < size) ? std::min<uint32_t>(m_length, size - m_position) : 0;
+
+			for (uint32_t i = 0; i < count; i++)
+				space.write_byte((m_pointer + i) & 0xffff, (*m_contents)[m_position + i]);
+			m_position += count;
+			m_length = count;
+		}
+		break;
+
+	case CMD_WRITE:
+		if (m_name.empty() || !m_writing || m_position + m_length > MAX_SIZE)
+			m_status = STATUS_ERROR;
+		else
+		{
+			if (m_output.size() < m_position + m_length)
+				m_output.resize(m_position + m_length);
+			for (uint32_t i = 0; i < m_length; i++)
+				m_output[m_position + i] = space.read_byte((m_pointer + i) & 0xffff);
+			m_position += m_length;
+		}
+		break;
+
+	case CMD_CLOSE:
+		if (!m_name.empty() && m_writing)
+			store(m_name, std::move(m_output));
+		m_name.clear();
+		m_contents.reset();
+		m_output.clear();
+		break;
+
+	case CMD_SIZE:
+		if (m_name.empty())
+			m_status = STATUS_ERROR;
+		else
+			m_position = m_writing ? m_output.size() : m_contents->size();
+		break;
+
+	default:
+		logerror("unknown command %02X\n", command);
+		m_status = STATUS_ERROR;
+		break;
+	}
+}
@@ -0,0 +1,82 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 host directory bridge
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_HOSTFS_H
+#define MAME_MACHINE_KIM1_HOSTFS_H
+
+#pragma once
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+class kim1_hostfs_device : public device_t
+{
+public:
+	// construction/destruction
+	kim1_hostfs_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock);
+
+	DECLARE_READ8_MEMBER( read );
+	DECLARE_WRITE8_MEMBER( write );
+
+	// shared with the host-call port, so both keep to the same files
+	static bool valid_name(const std::string &name);
+
+protected:
+	// device-level overrides
+	virtual void device_start() override;
+	virtual void device_reset() override;
+
+private:
+	enum
+	{
+		CMD_OPEN_READ = 0x01,   // open the file named at the pointer for reading
+		CMD_OPEN_WRITE = 0x02,  // create or replace the file named at the pointer
+		CMD_READ = 0x03,        // read up to length bytes to the pointer
+		CMD_WRITE = 0x04,       // write length bytes from the pointer
+		CMD_CLOSE = 0x05,       // close, writing the file out if it was created
+		CMD_SIZE = 0x06         // file size into the position registers
+	};
+
+	enum
+	{
+		STATUS_OK = 0x00,
+		STATUS_ERROR = 0x80
+	};
+
+	enum
+	{
+		MAX_SIZE = 0x10000      // largest file written, the whole address space
+	};
+
+	typedef std::shared_ptr<const std::vector<uint8_t>> contents_ptr;
+
+	void execute(address_space &space, uint8_t command);
+	contents_ptr load(const std::string &name);
+	void store(const std::string &name, std::vector<uint8_t> &&data);
+
+	const char *m_directory;
+
+	uint8_t m_status;
+	uint16_t m_pointer;
+	uint16_t m_length;
+	uint32_t m_position;
+
+	// the open file: contents being read, or being written
+	std::string m_name;
+	bool m_writing;
+	contents_ptr m_contents;
+	std::vector<uint8_t> m_output;
+};
+
+
+// device type definition
+DECLARE_DEVICE_TYPE(KIM1_HOSTFS, kim1_hostfs_device)
+
+#endif // MAME_MACHINE_KIM1_HOSTFS_H
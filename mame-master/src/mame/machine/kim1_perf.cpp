@@ -0,0 +1,159 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 performance counter card
+
+    Free-running 32-bit counters for profiling from inside the guest,
+    which the RIOT timers wrap too quickly for:
+
+        0   CPU cycles
+        1   instructions executed
+        2   interrupts (IRQ and NMI) taken
+        3   writes to the video window
+        4   RIOT port accesses (keypad, display and cassette)
+
+    Registers:
+        00-13   counter n at 4n, low byte first
+        1F      W: control (bit 0 = clear all, bit 1 = latch all)
+
+    Reading the low byte of a counter latches all 32 bits of it, and
+    the other three bytes read from the latch, so a counter read low
+    byte first is consistent. Latching all counters at once with the
+    control register gives a consistent set: the next read of each
+    low byte comes from that latch instead of latching afresh.
+
+    Timing a loop:
+
+        LDA #$02        ; latch all
+        STA $E07F
+        LDA $E060       ; cycles, low byte first
+        STA START
+        LDA $E061
+        STA START+1
+        ...
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_perf.h"
+
+
+//**************************************************************************
+//  DEVICE DEFINITIONS
+//**************************************************************************
+
+DEFINE_DEVICE_TYPE(KIM1_PERF, kim1_perf_device, "kim1_perf", "KIM-1 Performance Counter Card")
+
+
+//**************************************************************************
+//  LIVE DEVICE
+//**************************************************************************
+
+//-------------------------------------------------
+//  kim1_perf_device - constructor
+//-------------------------------------------------
+
+kim1_perf_device::kim1_perf_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock)
+	: device_t(mconfig, KIM1_PERF, tag, owner, clock),
+	m_cpu(*this, finder_base::DUMMY_TAG),
+	m_cycle_base(0),
+	m_held(0)
+{
+}
+
+
+//-------------------------------------------------
+//  device_start - device-specific startup
+//-------------------------------------------------
+
+void kim1_perf_device::device_start()
+{
+	clear();
+	memset(m_latch, 0, sizeof(m_latch));
+
+	save_item(NAME(m_count));
+	save_item(NAME(m_latch));
+	save_item(NAME(m_cycle_base));
+	save_item(NAME(m_held));
+}
+
+
+//-------------------------------------------------
+//  device_reset - device-specific reset
+//-------------------------------------------------
+
+void kim1_perf_device::device_reset()
+{
+	clear();
+}
+
+
+//-------------------------------------------------
+//  value - the current value of a counter
+//-------------------------------------------------
+
+uint32_t kim1_perf_device::value(int counter) const
+{
+	if (counter == COUNTER_CYCLES)
+		return uint32_t(m_cpu->total_cycles() - m_cycle_base);
+
+	return m_count[counter];
+}
+
+
+//-------------------------------------------------
+//  clear - zero all the counters
+//-------------------------------------------------
+
+void kim1_perf_device::clear()
+{
+	memset(m_count, 0, sizeof(m_count));
+	m_held = 0;
+	m_cycle_base = m_cpu->total_cycles();
+}
+
+
+//-------------------------------------------------
+//  read -
+//-------------------------------------------------
+
+READ8_MEMBER( kim1_perf_device::read )
+{
+	int counter = offset >> 2;
+	int byte = offset & 3;
+
+	if (counter >= COUNTER_COUNT)
+		return 0xff;
+
+	if (byte == 0 && !machine().side_effect_disabled())
+	{
+		if (BIT(m_held, counter))
+			m_held &= ~(1 << counter);
+		else
+			m_latch[counter] = value(counter);
+	}
+
+	return (m_latch[counter] >> (byte * 8)) & 0xff;
+}
+
+
+//-------------------------------------------------
+//  write -
+//-------------------------------------------------
+
+WRITE8_MEMBER( kim1_perf_device::write )
+{
+	if (offset != 0x1f)
+		return;
+
+	if (data & CONTROL_CLEAR)
+		clear();
+
+	if (data & CONTROL_LATCH)
+	{
+		for (int counter = 0; counter < COUNTER_COUNT; counter++)
+			m_latch[counter] = value(counter);
+		m_held = (1 << COUNTER_COUNT) - 1;
+	}
+}
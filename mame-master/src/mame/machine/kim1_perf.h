@@ -0,0 +1,79 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 performance counter card
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_PERF_H
+#define MAME_MACHINE_KIM1_PERF_H
+
+#pragma once
+
+
+//**************************************************************************
+//  INTERFACE CONFIGURATION MACROS
+//**************************************************************************
+
+#define MCFG_KIM1_PERF_CPU(_tag) \
+	kim1_perf_device::set_cpu_tag(*device, "^" _tag);
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+class kim1_perf_device : public device_t
+{
+public:
+	enum
+	{
+		COUNTER_CYCLES,
+		COUNTER_INSTRUCTIONS,
+		COUNTER_IRQS,
+		COUNTER_VRAM_WRITES,
+		COUNTER_RIOT_ACCESSES,
+		COUNTER_COUNT
+	};
+
+	// construction/destruction
+	kim1_perf_device(const machine_config &mconfig, const char *tag, device_t *owner, uint32_t clock);
+
+	static void set_cpu_tag(device_t &device, const char *tag) { downcast<kim1_perf_device &>(device).m_cpu.set_tag(tag); }
+
+	// event counting, from driver hooks
+	void count(int counter) { m_count[counter]++; }
+	DECLARE_WRITE_LINE_MEMBER( sync_w ) { if (state) m_count[COUNTER_INSTRUCTIONS]++; }
+
+	DECLARE_READ8_MEMBER( read );
+	DECLARE_WRITE8_MEMBER( write );
+
+protected:
+	// device-level overrides
+	virtual void device_start() override;
+	virtual void device_reset() override;
+
+private:
+	enum
+	{
+		CONTROL_CLEAR = 0x01,
+		CONTROL_LATCH = 0x02
+	};
+
+	uint32_t value(int counter) const;
+	void clear();
+
+	required_device<cpu_device> m_cpu;
+
+	uint32_t m_count[COUNTER_COUNT];
+	uint32_t m_latch[COUNTER_COUNT];
+	uint64_t m_cycle_base;
+	uint8_t m_held;
+};
+
+
+// device type definition
+DECLARE_DEVICE_TYPE(KIM1_PERF, kim1_perf_device)
+
+#endif // MAME_MACHINE_KIM1_PERF_H
@@ -0,0 +1,718 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 shared-memory mailbox, memory-mapped NVRAM, serial link,
+    differential check and control channels
+
+    Backs KIM-1 memory regions with a POSIX shared-memory object so host
+    tools can read the frame buffer and exchange data with the guest
+    without copies. The object starts with a kim1_shm_header page,
+    followed by each region page-aligned.
+
+    The sequence counter is a seqlock: it is odd while the machine is
+    emulating a frame and even between frames. A reader that sees the
+    same even value before and after its copy has a consistent
+    snapshot.
+
+    The NVRAM mapping keeps a RAM range in a file mapped with MAP_SHARED,
+    so writes persist with no per-write cost and a restart picks the
+    contents up straight away. The file's header holds a clean flag,
+    cleared while the file is mapped and set again after the final
+    msync(); finding it cleared on open means the previous run did not
+    exit cleanly.
+
+    The serial link joins two KIM-1s, each in its own process, through
+    a shared object holding a single-producer, single-consumer ring of
+    line changes for each direction. A change is stamped with the
+    sender's emulated time plus the link's lookahead, and each side
+    publishes how far it has run. Synchronisation is conservative:
+    before running on to a time, a side waits until the peer has run
+    to within the lookahead of it. Every change the peer can still
+    send is then stamped later than that time, so none can arrive in
+    a receiver's past, and the result does not depend on host
+    scheduling.
+
+    The differential check channel holds a snapshot of each of two
+    machines, one on the reference paths and one on the fast paths,
+    at matching check points. Each side publishes its snapshot, waits
+    for the other's, compares and says so; a side does not overwrite
+    its snapshot until the peer has compared the previous one.
+
+    The control channel lets a client such as libkim1 drive one
+    machine. The client creates the object and starts the emulator
+    with its name; the machine then stops between timeslices and
+    carries out one request at a time, running only when asked to
+    step. A request is posted by bumping its number and completed by
+    copying it to the done number, so each call costs a pair of
+    cache-line transfers.
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_shm.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define KIM1_SHM_POSIX 1
+#endif
+
+#include <chrono>
+#include <thread>
+
+
+//**************************************************************************
+//  SHARED MEMORY
+//**************************************************************************
+
+kim1_shared_memory::kim1_shared_memory()
+	: m_base(nullptr),
+	m_size(0),
+	m_header(nullptr)
+{
+}
+
+kim1_shared_memory::~kim1_shared_memory()
+{
+	close();
+}
+
+
+//-------------------------------------------------
+//  open - create and map the shared object,
+//  named after the prefix and our process ID
+//-------------------------------------------------
+
+bool kim1_shared_memory::open(const char *prefix, uint32_t ram_base, uint32_t ram_size, uint32_t vram_base, uint32_t vram_size)
+{
+#ifdef KIM1_SHM_POSIX
+	const size_t page = 4096;
+	const size_t ram_offset = page;
+	const size_t vram_offset = ram_offset + ((ram_size + page - 1) & ~(page - 1));
+	const size_t size = vram_offset + ((vram_size + page - 1) & ~(page - 1));
+
+	close();
+
+	std::string name = string_format("/%s.%d", prefix, int(getpid()));
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, size) != 0)
+	{
+		::close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED)
+	{
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	m_name = name;
+	m_base = reinterpret_cast<uint8_t *>(base);
+	m_size = size;
+	m_header = new (m_base) kim1_shm_header;
+	m_header->magic = kim1_shm_header::MAGIC;
+	m_header->version = kim1_shm_header::VERSION;
+	m_header->sequence.store(0);
+	m_header->frame = 0;
+	m_header->ram_base = ram_base;
+	m_header->ram_offset = ram_offset;
+	m_header->ram_size = ram_size;
+	m_header->vram_base = vram_base;
+	m_header->vram_offset = vram_offset;
+	m_header->vram_size = vram_size;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+//-------------------------------------------------
+//  close - unmap and remove the shared object
+//-------------------------------------------------
+
+void kim1_shared_memory::close()
+{
+#ifdef KIM1_SHM_POSIX
+	if (m_base != nullptr)
+	{
+		munmap(m_base, m_size);
+		shm_unlink(m_name.c_str());
+	}
+#endif
+	m_base = nullptr;
+	m_header = nullptr;
+	m_size = 0;
+	m_name.clear();
+}
+
+
+
+//**************************************************************************
+//  MEMORY-MAPPED NVRAM
+//**************************************************************************
+
+kim1_mapped_nvram::kim1_mapped_nvram()
+	: m_base(nullptr),
+	m_size(0),
+	m_header(nullptr)
+{
+}
+
+kim1_mapped_nvram::~kim1_mapped_nvram()
+{
+	close();
+}
+
+
+//-------------------------------------------------
+//  open - map the file, creating or resizing it
+//  if it does not hold a valid image
+//-------------------------------------------------
+
+bool kim1_mapped_nvram::open(const char *path, uint32_t size, state &result)
+{
+#ifdef KIM1_SHM_POSIX
+	const size_t total = 4096 + size;
+
+	close();
+
+	int fd = ::open(path, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+		return false;
+
+	off_t length = lseek(fd, 0, SEEK_END);
+	if ((length != off_t(total) && ftruncate(fd, total) != 0))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED)
+		return false;
+
+	m_base = reinterpret_cast<uint8_t *>(base);
+	m_size = total;
+	m_header = reinterpret_cast<kim1_nvram_header *>(m_base);
+
+	if (length != off_t(total) || m_header->magic != kim1_nvram_header::MAGIC || m_header->version != kim1_nvram_header::VERSION || m_header->size != size)
+	{
+		memset(m_base, 0, total);
+		m_header->magic = kim1_nvram_header::MAGIC;
+		m_header->version = kim1_nvram_header::VERSION;
+		m_header->size = size;
+		result = state::NEW;
+	}
+	else
+		result = m_header->clean ? state::CLEAN : state::UNCLEAN;
+
+	/* mark the image in use until we close it */
+	m_header->clean = 0;
+	msync(m_base, 4096, MS_SYNC);
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+//-------------------------------------------------
+//  close - flush and unmap, marking the image
+//  clean
+//-------------------------------------------------
+
+void kim1_mapped_nvram::close()
+{
+#ifdef KIM1_SHM_POSIX
+	if (m_base != nullptr)
+	{
+		msync(m_base, m_size, MS_SYNC);
+		m_header->clean = 1;
+		msync(m_base, 4096, MS_SYNC);
+		munmap(m_base, m_size);
+	}
+#endif
+	m_base = nullptr;
+	m_header = nullptr;
+	m_size = 0;
+}
+
+
+
+//**************************************************************************
+//  SERIAL LINK
+//**************************************************************************
+
+namespace {
+
+#ifdef KIM1_SHM_POSIX
+
+//-------------------------------------------------
+//  attach_object - map a shared object two
+//  processes meet at, creating it if we are first
+//-------------------------------------------------
+
+void *attach_object(const std::string &path, size_t size, bool &creator)
+{
+	creator = true;
+	int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+	{
+		creator = false;
+		fd = shm_open(path.c_str(), O_RDWR, 0600);
+		if (fd < 0)
+			return nullptr;
+	}
+
+	if (creator && ftruncate(fd, size) != 0)
+	{
+		::close(fd);
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+
+	/* the creator may not have sized the object yet */
+	struct stat st;
+	for (int tries = 0; !creator && (fstat(fd, &st) != 0 || size_t(st.st_size) < size); tries++)
+	{
+		if (tries == 1000)
+		{
+			::close(fd);
+			return nullptr;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED)
+	{
+		if (creator)
+			shm_unlink(path.c_str());
+		return nullptr;
+	}
+
+	return base;
+}
+
+
+//-------------------------------------------------
+//  wait_for_magic - wait for the creator to
+//  finish setting an object up
+//-------------------------------------------------
+
+bool wait_for_magic(const std::atomic<uint32_t> &magic, uint32_t expected)
+{
+	for (int tries = 0; magic.load(std::memory_order_acquire) != expected; tries++)
+	{
+		if (tries == 1000)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+#endif
+
+
+//-------------------------------------------------
+//  wait_on_peer - wait for a condition on the
+//  other process; a peer that is not attached,
+//  or stalls for a second (a paused emulator),
+//  is not waited for
+//-------------------------------------------------
+
+template <typename Condition>
+bool wait_on_peer(const std::atomic<uint32_t> &attached, Condition &&done)
+{
+	auto const start = std::chrono::steady_clock::now();
+	int spins = 0;
+
+	while (attached.load(std::memory_order_acquire) != 0 && !done())
+	{
+		if (++spins < 100)
+			std::this_thread::yield();
+		else if (std::chrono::steady_clock::now() - start > std::chrono::seconds(1))
+			return false;
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+
+	return true;
+}
+
+} // anonymous namespace
+
+
+kim1_serial_link::kim1_serial_link()
+	: m_header(nullptr),
+	m_side(0)
+{
+}
+
+kim1_serial_link::~kim1_serial_link()
+{
+	close();
+}
+
+
+//-------------------------------------------------
+//  open - map the link object, creating it if
+//  this side is first
+//-------------------------------------------------
+
+bool kim1_serial_link::open(const char *name, int side)
+{
+#ifdef KIM1_SHM_POSIX
+	close();
+
+	std::string path = string_format("/%s", name);
+	bool creator;
+	void *base = attach_object(path, sizeof(kim1_link_header), creator);
+	if (base == nullptr)
+		return false;
+
+	kim1_link_header *header = reinterpret_cast<kim1_link_header *>(base);
+	if (creator)
+	{
+		header->version = kim1_link_header::VERSION;
+		for (int i = 0; i < 2; i++)
+		{
+			header->attached[i].store(0);
+			header->time[i].store(0);
+			header->rings[i].head.store(0);
+			header->rings[i].tail.store(0);
+		}
+		header->magic.store(kim1_link_header::MAGIC, std::memory_order_release);
+	}
+
+	if (!wait_for_magic(header->magic, kim1_link_header::MAGIC) || header->version != kim1_link_header::VERSION || header->attached[side].exchange(1) != 0)
+	{
+		munmap(base, sizeof(kim1_link_header));
+		return false;
+	}
+
+	m_name = path;
+	m_header = header;
+	m_side = side;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+//-------------------------------------------------
+//  close - detach from the link, removing the
+//  object once both sides have gone
+//-------------------------------------------------
+
+void kim1_serial_link::close()
+{
+#ifdef KIM1_SHM_POSIX
+	if (m_header != nullptr)
+	{
+		m_header->attached[m_side].store(0, std::memory_order_release);
+		if (m_header->attached[m_side ^ 1].load(std::memory_order_acquire) == 0)
+			shm_unlink(m_name.c_str());
+		munmap(m_header, sizeof(kim1_link_header));
+	}
+#endif
+	m_header = nullptr;
+	m_name.clear();
+}
+
+
+//-------------------------------------------------
+//  send - queue a line change for the peer
+//-------------------------------------------------
+
+bool kim1_serial_link::send(uint64_t stamp, uint8_t level)
+{
+	kim1_link_header::ring &ring = m_header->rings[m_side];
+	uint32_t head = ring.head.load(std::memory_order_relaxed);
+
+	if (head - ring.tail.load(std::memory_order_acquire) >= kim1_link_header::RING_SIZE)
+		return false;
+
+	ring.stamp[head % kim1_link_header::RING_SIZE] = stamp;
+	ring.level[head % kim1_link_header::RING_SIZE] = level;
+	ring.head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+
+//-------------------------------------------------
+//  receive - take the peer's line changes up to
+//  now, leaving the line level in level
+//-------------------------------------------------
+
+bool kim1_serial_link::receive(uint64_t now, uint8_t &level)
+{
+	kim1_link_header::ring &ring = m_header->rings[m_side ^ 1];
+	uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+	uint32_t head = ring.head.load(std::memory_order_acquire);
+	bool changed = false;
+
+	while (tail != head && ring.stamp[tail % kim1_link_header::RING_SIZE] <= now)
+	{
+		level = ring.level[tail % kim1_link_header::RING_SIZE];
+		changed = true;
+		tail++;
+	}
+
+	ring.tail.store(tail, std::memory_order_release);
+	return changed;
+}
+
+
+//-------------------------------------------------
+//  wait_for_peer - hold this side until it is safe
+//  to run up to until: the peer's next change can
+//  be stamped no earlier than its time plus the
+//  lookahead
+//-------------------------------------------------
+
+bool kim1_serial_link::wait_for_peer(uint64_t until, uint64_t lookahead)
+{
+	auto const &peer_time = m_header->time[m_side ^ 1];
+
+	return wait_on_peer(m_header->attached[m_side ^ 1], [&] { return peer_time.load(std::memory_order_acquire) + lookahead >= until; });
+}
+
+
+
+//**************************************************************************
+//  DIFFERENTIAL CHECK CHANNEL
+//**************************************************************************
+
+kim1_diff_channel::kim1_diff_channel()
+	: m_header(nullptr),
+	m_side(0)
+{
+}
+
+kim1_diff_channel::~kim1_diff_channel()
+{
+	close();
+}
+
+
+//-------------------------------------------------
+//  open - map the channel object, creating it if
+//  this side is first
+//-------------------------------------------------
+
+bool kim1_diff_channel::open(const char *name, int side)
+{
+#ifdef KIM1_SHM_POSIX
+	close();
+
+	std::string path = string_format("/%s", name);
+	bool creator;
+	void *base = attach_object(path, sizeof(kim1_diff_header), creator);
+	if (base == nullptr)
+		return false;
+
+	kim1_diff_header *header = reinterpret_cast<kim1_diff_header *>(base);
+	if (creator)
+	{
+		header->version = kim1_diff_header::VERSION;
+		for (int i = 0; i < 2; i++)
+		{
+			header->attached[i].store(0);
+			header->snapshots[i].published.store(0);
+			header->snapshots[i].compared.store(0);
+		}
+		header->magic.store(kim1_diff_header::MAGIC, std::memory_order_release);
+	}
+
+	if (!wait_for_magic(header->magic, kim1_diff_header::MAGIC) || header->version != kim1_diff_header::VERSION || header->attached[side].exchange(1) != 0)
+	{
+		munmap(base, sizeof(kim1_diff_header));
+		return false;
+	}
+
+	m_name = path;
+	m_header = header;
+	m_side = side;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+//-------------------------------------------------
+//  close - detach from the channel, removing the
+//  object once both sides have gone
+//-------------------------------------------------
+
+void kim1_diff_channel::close()
+{
+#ifdef KIM1_SHM_POSIX
+	if (m_header != nullptr)
+	{
+		m_header->attached[m_side].store(0, std::memory_order_release);
+		if (m_header->attached[m_side ^ 1].load(std::memory_order_acquire) == 0)
+			shm_unlink(m_name.c_str());
+		munmap(m_header, sizeof(kim1_diff_header));
+	}
+#endif
+	m_header = nullptr;
+	m_name.clear();
+}
+
+
+//-------------------------------------------------
+//  wait_for_compared - wait until the peer has
+//  compared our snapshot for a check
+//-------------------------------------------------
+
+bool kim1_diff_channel::wait_for_compared(uint32_t check)
+{
+	auto const &compared = peer().compared;
+
+	return wait_on_peer(m_header->attached[m_side ^ 1], [&] { return compared.load(std::memory_order_acquire) >= check + 1; });
+}
+
+
+//-------------------------------------------------
+//  wait_for_published - wait until the peer has
+//  published its snapshot for a check; false if
+//  it never did
+//-------------------------------------------------
+
+bool kim1_diff_channel::wait_for_published(uint32_t check)
+{
+	auto const &published = peer().published;
+
+	return wait_on_peer(m_header->attached[m_side ^ 1], [&] { return published.load(std::memory_order_acquire) >= check + 1; }) &&
+			published.load(std::memory_order_acquire) >= check + 1;
+}
+
+
+
+//**************************************************************************
+//  CONTROL CHANNEL
+//**************************************************************************
+
+kim1_control_channel::kim1_control_channel()
+	: m_header(nullptr)
+{
+}
+
+kim1_control_channel::~kim1_control_channel()
+{
+	close();
+}
+
+
+//-------------------------------------------------
+//  open - map the channel object the client has
+//  made
+//-------------------------------------------------
+
+bool kim1_control_channel::open(const char *name)
+{
+#ifdef KIM1_SHM_POSIX
+	close();
+
+	/* the client creates the object, and may already have gone */
+	std::string path = string_format("/%s", name);
+	int fd = shm_open(path.c_str(), O_RDWR, 0600);
+	if (fd < 0)
+		return false;
+
+	void *base = mmap(nullptr, sizeof(kim1_control_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED)
+		return false;
+
+	kim1_control_header *header = reinterpret_cast<kim1_control_header *>(base);
+	if (!wait_for_magic(header->magic, kim1_control_header::MAGIC) || header->version != kim1_control_header::VERSION || header->attached[0].exchange(1) != 0)
+	{
+		munmap(base, sizeof(kim1_control_header));
+		return false;
+	}
+
+	m_name = path;
+	m_header = header;
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+//-------------------------------------------------
+//  close - detach from the channel
+//-------------------------------------------------
+
+void kim1_control_channel::close()
+{
+#ifdef KIM1_SHM_POSIX
+	if (m_header != nullptr)
+	{
+		m_header->attached[0].store(0, std::memory_order_release);
+		munmap(m_header, sizeof(kim1_control_header));
+	}
+#endif
+	m_header = nullptr;
+	m_name.clear();
+}
+
+
+//-------------------------------------------------
+//  wait_for_request - wait, for as long as the
+//  client stays attached and alive, for its next
+//  request; false once it has gone
+//-------------------------------------------------
+
+bool kim1_control_channel::wait_for_request()
+{
+	int spins = 0;
+
+	while (!pending())
+	{
+		if (m_header->attached[1].load(std::memory_order_acquire) == 0)
+			return false;
+		if (++spins < 1000)
+			std::this_thread::yield();
+		else
+		{
+#ifdef KIM1_SHM_POSIX
+			if ((spins % 1000) == 0 && kill(m_header->client_pid, 0) != 0 && errno == ESRCH)
+				return false;
+#endif
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+	return true;
+}
+
+
+//-------------------------------------------------
+//  complete - report the request as carried out
+//-------------------------------------------------
+
+void kim1_control_channel::complete(int32_t result)
+{
+	m_header->result = result;
+	m_header->done.store(m_header->request.load(std::memory_order_relaxed), std::memory_order_release);
+}
@@ -0,0 +1,293 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 shared-memory mailbox, memory-mapped NVRAM, serial link,
+    differential check and control channels
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_SHM_H
+#define MAME_MACHINE_KIM1_SHM_H
+
+#pragma once
+
+#include <atomic>
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+// layout of the start of the shared object; host tools map the same
+// object and find the regions through the offsets
+struct kim1_shm_header
+{
+	enum : uint32_t
+	{
+		MAGIC = 0x314d494b,             // "KIM1"
+		VERSION = 1
+	};
+
+	uint32_t magic;
+	uint32_t version;
+	std::atomic<uint32_t> sequence;     // odd while a frame is being emulated
+	uint32_t frame;                     // frames completed
+	uint32_t ram_base, ram_offset, ram_size;
+	uint32_t vram_base, vram_offset, vram_size;
+};
+
+
+class kim1_shared_memory
+{
+public:
+	kim1_shared_memory();
+	~kim1_shared_memory();
+
+	bool open(const char *prefix, uint32_t ram_base, uint32_t ram_size, uint32_t vram_base, uint32_t vram_size);
+	void close();
+
+	bool is_open() const { return m_header != nullptr; }
+	const std::string &name() const { return m_name; }
+	uint8_t *ram() const { return m_base + m_header->ram_offset; }
+	uint8_t *vram() const { return m_base + m_header->vram_offset; }
+
+	// seqlock around each emulated frame
+	void frame_begin() { m_header->sequence.fetch_add(1, std::memory_order_acq_rel); }
+	void frame_end() { m_header->frame++; m_header->sequence.fetch_add(1, std::memory_order_acq_rel); }
+
+private:
+	std::string m_name;
+	uint8_t *m_base;
+	size_t m_size;
+	kim1_shm_header *m_header;
+};
+
+
+// header at the start of a memory-mapped NVRAM file
+struct kim1_nvram_header
+{
+	enum : uint32_t
+	{
+		MAGIC = 0x31564e4b,             // "KNV1"
+		VERSION = 1
+	};
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t clean;                     // cleared while mapped, set on a clean close
+};
+
+
+class kim1_mapped_nvram
+{
+public:
+	enum class state
+	{
+		NEW,                            // file was created
+		CLEAN,                          // contents restored after a clean close
+		UNCLEAN                         // contents restored, but not closed cleanly
+	};
+
+	kim1_mapped_nvram();
+	~kim1_mapped_nvram();
+
+	bool open(const char *path, uint32_t size, state &result);
+	void close();
+
+	bool is_open() const { return m_header != nullptr; }
+	uint8_t *data() const { return m_base + 4096; }
+
+private:
+	uint8_t *m_base;
+	size_t m_size;
+	kim1_nvram_header *m_header;
+};
+
+
+// a serial link between two machines, in a shared object both map; each
+// side owns one ring of timestamped line changes and publishes how far
+// it has run
+struct kim1_link_header
+{
+	enum : uint32_t
+	{
+		MAGIC = 0x4c4d494b,             // "KIML"
+		VERSION = 1,
+		RING_SIZE = 1024
+	};
+
+	struct ring
+	{
+		std::atomic<uint32_t> head;     // written by the sender
+		std::atomic<uint32_t> tail;     // written by the receiver
+		uint64_t stamp[RING_SIZE];      // microseconds of emulated time
+		uint8_t level[RING_SIZE];
+	};
+
+	std::atomic<uint32_t> magic;        // set last, once the rest is ready
+	uint32_t version;
+	std::atomic<uint32_t> attached[2];
+	std::atomic<uint64_t> time[2];      // microseconds each side has reached
+	ring rings[2];                      // ring n is sent by side n
+};
+
+
+class kim1_serial_link
+{
+public:
+	kim1_serial_link();
+	~kim1_serial_link();
+
+	bool open(const char *name, int side);
+	void close();
+
+	bool is_open() const { return m_header != nullptr; }
+
+	bool send(uint64_t stamp, uint8_t level);
+	bool receive(uint64_t now, uint8_t &level);
+	void publish(uint64_t now) { m_header->time[m_side].store(now, std::memory_order_release); }
+	bool wait_for_peer(uint64_t until, uint64_t lookahead);
+
+private:
+	std::string m_name;
+	kim1_link_header *m_header;
+	int m_side;
+};
+
+
+// one side's state at a check point, for the differential check
+struct kim1_diff_snapshot
+{
+	enum : uint32_t
+	{
+		PAGES = 0x100
+	};
+
+	std::atomic<uint32_t> published;    // check number + 1, set last
+	std::atomic<uint32_t> compared;     // check number + 1 of the last peer snapshot compared
+	uint16_t pc;
+	uint8_t a, x, y, p, sp;
+	uint64_t cycles;
+	uint32_t page_hash[PAGES];          // of the pages being compared
+	uint8_t memory[PAGES * 0x100];
+};
+
+
+struct kim1_diff_header
+{
+	enum : uint32_t
+	{
+		MAGIC = 0x3144494b,             // "KID1"
+		VERSION = 1
+	};
+
+	std::atomic<uint32_t> magic;        // set last, once the rest is ready
+	uint32_t version;
+	std::atomic<uint32_t> attached[2];
+	kim1_diff_snapshot snapshots[2];    // snapshot n is written by side n
+};
+
+
+class kim1_diff_channel
+{
+public:
+	kim1_diff_channel();
+	~kim1_diff_channel();
+
+	bool open(const char *name, int side);
+	void close();
+
+	bool is_open() const { return m_header != nullptr; }
+
+	kim1_diff_snapshot &mine() { return m_header->snapshots[m_side]; }
+	const kim1_diff_snapshot &peer() const { return m_header->snapshots[m_side ^ 1]; }
+
+	bool wait_for_compared(uint32_t check);
+	void publish(uint32_t check) { mine().published.store(check + 1, std::memory_order_release); }
+	bool wait_for_published(uint32_t check);
+	void compared(uint32_t check) { mine().compared.store(check + 1, std::memory_order_release); }
+
+private:
+	std::string m_name;
+	kim1_diff_header *m_header;
+	int m_side;
+};
+
+
+// a control channel a test service drives the machine through (see
+// src/tools/libkim1); the client posts one request at a time and the
+// machine carries it out while stopped between timeslices
+struct kim1_control_header
+{
+	enum : uint32_t
+	{
+		MAGIC = 0x434d494b,             // "KIMC"
+		VERSION = 2,
+		VRAM_SIZE = 0x2000,
+		THUMB_COLS = 80,
+		THUMB_ROWS = 50,
+		DATA_SIZE = 0x40000
+	};
+
+	enum : uint32_t
+	{
+		STEP = 1,                       // run for length cycles
+		READ,                           // length bytes from address into data
+		WRITE,                          // length bytes of data to address
+		SET_PC,                         // continue at address
+		KEYS,                           // hold the keypad keys set in address
+		SAVE,                           // a snapshot into data, its size in length
+		RESTORE,                        // the snapshot in data
+		EXIT,
+		TEXT,                           // text row address into data
+		LEARN,                          // glyphs of text row address from data, the count in length
+		WAIT_PC,                        // run until address is fetched as an opcode
+		WAIT_LEDS,                      // run until the LEDs show the string in data
+		WAIT_VRAM                       // run until video RAM from address to end is written
+	};
+
+	std::atomic<uint32_t> magic;        // set last, once the rest is ready
+	uint32_t version;
+	std::atomic<uint32_t> attached[2];  // 0 is the machine, 1 the client
+	int32_t client_pid;                 // so a client that dies is noticed
+	std::atomic<uint32_t> request;      // number of the last request posted
+	std::atomic<uint32_t> done;         // number of the last request carried out
+	uint32_t command;
+	uint32_t address;
+	uint32_t length;                    // for the waits, a cycle limit or 0 for none
+	uint32_t end;
+	int32_t result;                     // 0, 1 if a wait ran out of cycles, or -1 if it failed
+	uint64_t cycles;                    // machine cycles run so far
+	uint32_t vram_serial;               // changes with the contents of vram
+	uint8_t vram[VRAM_SIZE];            // A000-BFFF as of the last request
+	uint32_t thumb_serial;              // changes with the contents of thumbnail
+	uint8_t thumbnail[THUMB_COLS * THUMB_ROWS]; // greyscale 4x4 blocks as of the last frame
+	uint8_t data[DATA_SIZE];
+};
+
+
+// the machine's end of a control channel
+class kim1_control_channel
+{
+public:
+	kim1_control_channel();
+	~kim1_control_channel();
+
+	bool open(const char *name);
+	void close();
+
+	bool is_open() const { return m_header != nullptr; }
+	kim1_control_header &header() { return *m_header; }
+
+	bool pending() const { return m_header->request.load(std::memory_order_acquire) != m_header->done.load(std::memory_order_relaxed); }
+	bool wait_for_request();
+	void complete(int32_t result);
+
+private:
+	std::string m_name;
+	kim1_control_header *m_header;
+};
+
+#endif // MAME_MACHINE_KIM1_SHM_H
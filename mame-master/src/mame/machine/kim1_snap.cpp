@@ -0,0 +1,285 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 delta-encoded snapshot store
+
+    Keeps many snapshots of one machine in a single file. Record 0 is
+    the base snapshot; every other record is the XOR of a snapshot
+    with the base, so any record can be decoded on its own, with one
+    seek and one read. Snapshots taken from the same starting point
+    mostly match the base, so their XOR is mostly zeros; it is stored
+    as alternating zero-run and literal-run lengths (LEB128) followed
+    by the literal bytes. The base itself is stored the same way,
+    against zeros, which suits the empty RAM and video window.
+
+    File layout:
+        0   "KDS1"
+        4   snapshot size in bytes
+        8   reserved (0)
+        16  records, each a 32-bit length then the coded data
+
+**********************************************************************/
+
+#include "emu.h"
+#include "kim1_snap.h"
+
+
+namespace {
+
+inline void put_length(std::vector<uint8_t> &out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	out.push_back(value);
+}
+
+inline bool get_length(const uint8_t *&data, const uint8_t *end, uint32_t &value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (data == end)
+			return false;
+		uint8_t byte = *data++;
+		value |= uint32_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+} // anonymous namespace
+
+
+
+//**************************************************************************
+//  CODEC
+//**************************************************************************
+
+//-------------------------------------------------
+//  encode - code the XOR of state and base;
+//  a null base is all zeros
+//-------------------------------------------------
+
+void kim1_snapshot_store::encode(const uint8_t *base, const uint8_t *state, uint32_t size, std::vector<uint8_t> &out)
+{
+	uint32_t pos = 0;
+
+	out.clear();
+	while (pos < size)
+	{
+		/* run of matching bytes, a word at a time where possible */
+		uint32_t start = pos;
+		while (pos + 8 <= size)
+		{
+			uint64_t a, b = 0;
+			memcpy(&a, state + pos, 8);
+			if (base != nullptr)
+				memcpy(&b, base + pos, 8);
+			if (a != b)
+				break;
+			pos += 8;
+		}
+		while (pos < size && state[pos] == (base ? base[pos] : 0))
+			pos++;
+		put_length(out, pos - start);
+
+		/* run of differing bytes; short matches stay in the run */
+		start = pos;
+		uint32_t same = 0;
+		while (pos < size && same < 4)
+		{
+			same = (state[pos] == (base ? base[pos] : 0)) ? same + 1 : 0;
+			pos++;
+		}
+		if (same >= 4)
+			pos -= same;
+		put_length(out, pos - start);
+		for (uint32_t i = start; i < pos; i++)
+			out.push_back(state[i] ^ (base ? base[i] : 0));
+	}
+}
+
+
+//-------------------------------------------------
+//  decode - rebuild a snapshot from its coding
+//-------------------------------------------------
+
+bool kim1_snapshot_store::decode(const uint8_t *base, const uint8_t *data, uint32_t length, uint8_t *state, uint32_t size)
+{
+	const uint8_t *end = data + length;
+	uint32_t pos = 0;
+
+	if (base != nullptr)
+		memcpy(state, base, size);
+	else
+		memset(state, 0, size);
+
+	while (data != end)
+	{
+		uint32_t zeros, literals;
+
+		if (!get_length(data, end, zeros) || !get_length(data, end, literals))
+			return false;
+		if (zeros > size - pos || literals > size - pos - zeros || literals > uint32_t(end - data))
+			return false;
+
+		pos += zeros;
+		for (uint32_t i = 0; i < literals; i++)
+			state[pos++] ^= *data++;
+	}
+
+	return pos == size;
+}
+
+
+
+//**************************************************************************
+//  STORE
+//**************************************************************************
+
+kim1_snapshot_store::kim1_snapshot_store()
+	: m_file(nullptr)
+{
+}
+
+
+//-------------------------------------------------
+//  create - start a store in an empty file,
+//  with the given base snapshot
+//-------------------------------------------------
+
+bool kim1_snapshot_store::create(emu_file &file, const std::vector<uint8_t> &base)
+{
+	uint32_t header[4] = { little_endianize_int32(MAGIC), little_endianize_int32(base.size()), 0, 0 };
+
+	close();
+	file.seek(0, SEEK_SET);
+	if (file.write(header, HEADER_SIZE) != HEADER_SIZE)
+		return false;
+
+	m_file = &file;
+	m_base = base;
+	m_offsets.assign(1, HEADER_SIZE);
+
+	encode(nullptr, base.data(), base.size(), m_buffer);
+	if (!write_record(m_buffer))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+//-------------------------------------------------
+//  open - pick up an existing store, indexing its
+//  records and decoding the base
+//-------------------------------------------------
+
+bool kim1_snapshot_store::open(emu_file &file, uint32_t size)
+{
+	uint32_t header[4];
+
+	close();
+	file.seek(0, SEEK_SET);
+	if (file.read(header, HEADER_SIZE) != HEADER_SIZE || little_endianize_int32(header[0]) != MAGIC || little_endianize_int32(header[1]) != size)
+		return false;
+
+	/* index the records by walking their lengths */
+	uint64_t end = file.size();
+	uint64_t offset = HEADER_SIZE;
+	m_offsets.clear();
+	while (offset + 4 <= end)
+	{
+		uint32_t length;
+		file.seek(offset, SEEK_SET);
+		if (file.read(&length, 4) != 4 || offset + 4 + little_endianize_int32(length) > end)
+			break;
+		m_offsets.push_back(offset);
+		offset += 4 + little_endianize_int32(length);
+	}
+	m_offsets.push_back(offset);
+	if (m_offsets.size() < 2)
+		return false;
+
+	/* decode the base against zeros */
+	m_file = &file;
+	m_base.clear();
+	std::vector<uint8_t> base(size);
+	if (!fetch(0, base))
+	{
+		close();
+		return false;
+	}
+	m_base = std::move(base);
+	return true;
+}
+
+
+void kim1_snapshot_store::close()
+{
+	m_file = nullptr;
+	m_base.clear();
+	m_offsets.clear();
+}
+
+
+//-------------------------------------------------
+//  append - add a snapshot, returning its index
+//  or -1 on error
+//-------------------------------------------------
+
+int kim1_snapshot_store::append(const std::vector<uint8_t> &state)
+{
+	if (state.size() != m_base.size())
+		return -1;
+
+	encode(m_base.data(), state.data(), state.size(), m_buffer);
+	if (!write_record(m_buffer))
+		return -1;
+	return count() - 1;
+}
+
+
+//-------------------------------------------------
+//  fetch - decode a snapshot by index; 0 is the
+//  base
+//-------------------------------------------------
+
+bool kim1_snapshot_store::fetch(uint32_t index, std::vector<uint8_t> &state)
+{
+	if (index + 1 >= m_offsets.size())
+		return false;
+
+	uint32_t length = m_offsets[index + 1] - m_offsets[index] - 4;
+	m_buffer.resize(length);
+	m_file->seek(m_offsets[index] + 4, SEEK_SET);
+	if (m_file->read(m_buffer.data(), length) != length)
+		return false;
+
+	return decode((index != 0) ? m_base.data() : nullptr, m_buffer.data(), length, state.data(), state.size());
+}
+
+
+//-------------------------------------------------
+//  write_record - append a record at the end
+//-------------------------------------------------
+
+bool kim1_snapshot_store::write_record(const std::vector<uint8_t> &record)
+{
+	uint64_t offset = m_offsets.back();
+	uint32_t length = little_endianize_int32(record.size());
+
+	m_file->seek(offset, SEEK_SET);
+	if (m_file->write(&length, 4) != 4 || m_file->write(record.data(), record.size()) != record.size())
+		return false;
+
+	m_offsets.back() = offset;
+	m_offsets.push_back(offset + 4 + record.size());
+	return true;
+}
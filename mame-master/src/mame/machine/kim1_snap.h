@@ -0,0 +1,53 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    KIM-1 delta-encoded snapshot store
+
+**********************************************************************/
+
+#ifndef MAME_MACHINE_KIM1_SNAP_H
+#define MAME_MACHINE_KIM1_SNAP_H
+
+#pragma once
+
+
+//**************************************************************************
+//  TYPE DEFINITIONS
+//**************************************************************************
+
+class kim1_snapshot_store
+{
+public:
+	kim1_snapshot_store();
+
+	bool create(emu_file &file, const std::vector<uint8_t> &base);
+	bool open(emu_file &file, uint32_t size);
+	void close();
+
+	bool is_open() const { return m_file != nullptr; }
+	uint32_t count() const { return m_offsets.size() - 1; }   // records, the base included
+
+	int append(const std::vector<uint8_t> &state);
+	bool fetch(uint32_t index, std::vector<uint8_t> &state);
+
+	// XOR delta against a base, with zero runs coded by length
+	static void encode(const uint8_t *base, const uint8_t *state, uint32_t size, std::vector<uint8_t> &out);
+	static bool decode(const uint8_t *base, const uint8_t *data, uint32_t length, uint8_t *state, uint32_t size);
+
+private:
+	enum : uint32_t
+	{
+		MAGIC = 0x3153444b,             // "KDS1"
+		HEADER_SIZE = 16
+	};
+
+	bool write_record(const std::vector<uint8_t> &record);
+
+	emu_file *m_file;
+	std::vector<uint8_t> m_base;
+	std::vector<uint64_t> m_offsets;    // of each record, and the end
+	std::vector<uint8_t> m_buffer;
+};
+
+#endif // MAME_MACHINE_KIM1_SNAP_H
@@ -0,0 +1,434 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    libkim1 - drive KIM-1 machines from a test service
+
+    The client end of the KIM-1 control channel. This file builds on its
+    own as a static or shared library; it needs only POSIX shared memory
+    and posix_spawn, and nothing from the emulator but the layout of the
+    control object.
+
+    A handle creates the control object, then starts the emulator with
+    the object's name in KIM1_CTL. Once the machine has attached, the
+    object is unlinked so nothing is left behind however either side
+    exits. A request fills in the command fields, bumps the request
+    number and waits, spinning briefly, for the machine to copy it to
+    the done number.
+
+**********************************************************************/
+
+#include "libkim1.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../../mame/machine/kim1_shm.h"
+
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+
+struct kim1_instance
+{
+	kim1_control_header *ctl;
+	pid_t pid;
+	uint32_t request;
+	bool busy;          // a request has been posted and not yet finished
+};
+
+
+namespace {
+
+// how long the emulator gets to start up and attach
+constexpr auto START_TIMEOUT = std::chrono::seconds(60);
+
+
+//-------------------------------------------------
+//  machine_alive - true while the emulator is
+//  attached and running
+//-------------------------------------------------
+
+bool machine_alive(kim1_instance *kim1)
+{
+	return kim1->ctl->attached[0].load(std::memory_order_acquire) != 0 && waitpid(kim1->pid, nullptr, WNOHANG) == 0;
+}
+
+
+//-------------------------------------------------
+//  post - hand the machine a request without
+//  waiting for it
+//-------------------------------------------------
+
+int post(kim1_instance *kim1, uint32_t command, uint32_t address, uint32_t length, uint32_t end = 0)
+{
+	kim1_control_header &ctl = *kim1->ctl;
+
+	if (kim1->busy)
+		return -1;
+
+	ctl.command = command;
+	ctl.address = address;
+	ctl.length = length;
+	ctl.end = end;
+	ctl.request.store(++kim1->request, std::memory_order_release);
+	kim1->busy = true;
+	return 0;
+}
+
+
+//-------------------------------------------------
+//  finished - true once the posted request has
+//  been carried out
+//-------------------------------------------------
+
+bool finished(kim1_instance *kim1)
+{
+	if (kim1->ctl->done.load(std::memory_order_acquire) != kim1->request)
+		return false;
+	kim1->busy = false;
+	return true;
+}
+
+
+//-------------------------------------------------
+//  call - post a request and wait for it to be
+//  carried out
+//-------------------------------------------------
+
+int call(kim1_instance *kim1, uint32_t command, uint32_t address, uint32_t length, uint32_t end = 0)
+{
+	int spins = 0;
+
+	if (post(kim1, command, address, length, end) != 0)
+		return -1;
+
+	while (!finished(kim1))
+	{
+		if (++spins < 1000)
+			std::this_thread::yield();
+		else if (!machine_alive(kim1))
+		{
+			kim1->busy = false;
+			return -1;
+		}
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(20));
+	}
+
+	return kim1->ctl->result;
+}
+
+
+//-------------------------------------------------
+//  set_leds - put a wait's digits in the data
+//  area
+//-------------------------------------------------
+
+bool set_leds(kim1_instance *kim1, const char *digits)
+{
+	size_t const length = strlen(digits);
+	if (length > 6 || kim1->busy)
+		return false;
+	memcpy(kim1->ctl->data, digits, length + 1);
+	return true;
+}
+
+} // anonymous namespace
+
+
+kim1_instance *kim1_create(const char *mame, const char *const *args)
+{
+	static std::atomic<uint32_t> serial(0);
+	std::string name = "kim1-ctl-" + std::to_string(getpid()) + "-" + std::to_string(serial++);
+	std::string path = "/" + name;
+
+	/* the control object, ready before the machine looks for it */
+	int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+		return nullptr;
+	void *base = MAP_FAILED;
+	if (ftruncate(fd, sizeof(kim1_control_header)) == 0)
+		base = mmap(nullptr, sizeof(kim1_control_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+
+	kim1_instance *kim1 = new kim1_instance;
+	kim1->ctl = reinterpret_cast<kim1_control_header *>(base);
+	kim1->pid = -1;
+	kim1->request = 0;
+	kim1->busy = false;
+
+	kim1_control_header &ctl = *kim1->ctl;
+	ctl.version = kim1_control_header::VERSION;
+	ctl.attached[0].store(0);
+	ctl.attached[1].store(1);
+	ctl.client_pid = getpid();
+	ctl.request.store(0);
+	ctl.done.store(0);
+	ctl.vram_serial = ~0U;
+	ctl.thumb_serial = ~0U;
+	ctl.magic.store(kim1_control_header::MAGIC, std::memory_order_release);
+
+	/* mame kim1 with no window, sound or throttle, then the caller's options */
+	std::vector<std::string> argv = { mame, "kim1", "-video", "none", "-sound", "none", "-nothrottle", "-skip_gameinfo" };
+	for (int i = 0; args != nullptr && args[i] != nullptr; i++)
+		argv.push_back(args[i]);
+	std::vector<char *> argp;
+	for (std::string &arg : argv)
+		argp.push_back(&arg[0]);
+	argp.push_back(nullptr);
+
+	std::vector<std::string> env = { "KIM1_CTL=" + name };
+	for (char **var = environ; *var != nullptr; var++)
+		if (strncmp(*var, "KIM1_CTL=", 9) != 0)
+			env.push_back(*var);
+	std::vector<char *> envp;
+	for (std::string &var : env)
+		envp.push_back(&var[0]);
+	envp.push_back(nullptr);
+
+	pid_t pid;
+	bool started = posix_spawnp(&pid, mame, nullptr, nullptr, argp.data(), envp.data()) == 0;
+	if (started)
+	{
+		kim1->pid = pid;
+
+		/* the machine attaches when it first resets */
+		auto const start = std::chrono::steady_clock::now();
+		while (ctl.attached[0].load(std::memory_order_acquire) == 0)
+		{
+			if (waitpid(pid, nullptr, WNOHANG) != 0 || std::chrono::steady_clock::now() - start > START_TIMEOUT)
+			{
+				started = false;
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	shm_unlink(path.c_str());
+
+	if (!started)
+	{
+		if (kim1->pid > 0)
+		{
+			kill(kim1->pid, SIGTERM);
+			waitpid(kim1->pid, nullptr, 0);
+		}
+		munmap(kim1->ctl, sizeof(kim1_control_header));
+		delete kim1;
+		return nullptr;
+	}
+
+	return kim1;
+}
+
+
+void kim1_destroy(kim1_instance *kim1)
+{
+	if (kim1 == nullptr)
+		return;
+
+	/* ask nicely; a machine that has gone quiet sees us detach instead,
+	   and one still running a request is told to stop */
+	if (kim1->busy && !finished(kim1))
+		kill(kim1->pid, SIGTERM);
+	else if (machine_alive(kim1))
+		call(kim1, kim1_control_header::EXIT, 0, 0);
+	kim1->ctl->attached[1].store(0, std::memory_order_release);
+	waitpid(kim1->pid, nullptr, 0);
+
+	munmap(kim1->ctl, sizeof(kim1_control_header));
+	delete kim1;
+}
+
+
+int kim1_step(kim1_instance *kim1, uint32_t cycles)
+{
+	return call(kim1, kim1_control_header::STEP, 0, cycles);
+}
+
+
+uint64_t kim1_cycles(kim1_instance *kim1)
+{
+	return kim1->ctl->cycles;
+}
+
+
+int kim1_read(kim1_instance *kim1, uint16_t address, void *buffer, size_t length)
+{
+	if (length > size_t(0x10000) - address)
+		return -1;
+	if (call(kim1, kim1_control_header::READ, address, length) != 0)
+		return -1;
+	memcpy(buffer, kim1->ctl->data, length);
+	return 0;
+}
+
+
+int kim1_write(kim1_instance *kim1, uint16_t address, const void *buffer, size_t length)
+{
+	if (length > size_t(0x10000) - address)
+		return -1;
+	memcpy(kim1->ctl->data, buffer, length);
+	return call(kim1, kim1_control_header::WRITE, address, length);
+}
+
+
+int kim1_load(kim1_instance *kim1, uint16_t address, const void *program, size_t length)
+{
+	if (kim1_write(kim1, address, program, length) != 0)
+		return -1;
+	return kim1_set_pc(kim1, address);
+}
+
+
+int kim1_set_pc(kim1_instance *kim1, uint16_t pc)
+{
+	return call(kim1, kim1_control_header::SET_PC, pc, 0);
+}
+
+
+int kim1_set_keys(kim1_instance *kim1, uint32_t mask)
+{
+	return call(kim1, kim1_control_header::KEYS, mask, 0);
+}
+
+
+const uint8_t *kim1_framebuffer(kim1_instance *kim1, size_t *length, uint32_t *serial)
+{
+	if (length != nullptr)
+		*length = kim1_control_header::VRAM_SIZE;
+	if (serial != nullptr)
+		*serial = kim1->ctl->vram_serial;
+	return kim1->ctl->vram;
+}
+
+
+const uint8_t *kim1_thumbnail(kim1_instance *kim1, int *columns, int *rows, uint32_t *serial)
+{
+	if (columns != nullptr)
+		*columns = kim1_control_header::THUMB_COLS;
+	if (rows != nullptr)
+		*rows = kim1_control_header::THUMB_ROWS;
+	if (serial != nullptr)
+		*serial = kim1->ctl->thumb_serial;
+	return kim1->ctl->thumbnail;
+}
+
+
+int kim1_wait_pc(kim1_instance *kim1, uint16_t pc, uint32_t max_cycles)
+{
+	return call(kim1, kim1_control_header::WAIT_PC, pc, max_cycles);
+}
+
+
+int kim1_wait_leds(kim1_instance *kim1, const char *digits, uint32_t max_cycles)
+{
+	if (!set_leds(kim1, digits))
+		return -1;
+	return call(kim1, kim1_control_header::WAIT_LEDS, 0, max_cycles);
+}
+
+
+int kim1_wait_vram_write(kim1_instance *kim1, uint16_t start, uint16_t end, uint32_t max_cycles)
+{
+	return call(kim1, kim1_control_header::WAIT_VRAM, start, max_cycles, end);
+}
+
+
+int kim1_start_step(kim1_instance *kim1, uint32_t cycles)
+{
+	return post(kim1, kim1_control_header::STEP, 0, cycles);
+}
+
+
+int kim1_start_wait_pc(kim1_instance *kim1, uint16_t pc, uint32_t max_cycles)
+{
+	return post(kim1, kim1_control_header::WAIT_PC, pc, max_cycles);
+}
+
+
+int kim1_start_wait_leds(kim1_instance *kim1, const char *digits, uint32_t max_cycles)
+{
+	if (!set_leds(kim1, digits))
+		return -1;
+	return post(kim1, kim1_control_header::WAIT_LEDS, 0, max_cycles);
+}
+
+
+int kim1_start_wait_vram_write(kim1_instance *kim1, uint16_t start, uint16_t end, uint32_t max_cycles)
+{
+	return post(kim1, kim1_control_header::WAIT_VRAM, start, max_cycles, end);
+}
+
+
+int kim1_poll(kim1_instance *kim1)
+{
+	if (!kim1->busy)
+		return -1;
+	if (finished(kim1))
+		return kim1->ctl->result;
+	if (!machine_alive(kim1))
+	{
+		kim1->busy = false;
+		return -1;
+	}
+	return KIM1_BUSY;
+}
+
+
+int kim1_text_row(kim1_instance *kim1, int row, char *buffer, size_t size)
+{
+	if (row < 0 || size == 0 || call(kim1, kim1_control_header::TEXT, row, 0) != 0)
+		return -1;
+	strncpy(buffer, reinterpret_cast<const char *>(kim1->ctl->data), size - 1);
+	buffer[size - 1] = 0;
+	return 0;
+}
+
+
+int kim1_text_learn(kim1_instance *kim1, int row, const char *text)
+{
+	size_t const length = strlen(text);
+	if (row < 0 || length >= kim1_control_header::DATA_SIZE)
+		return -1;
+	memcpy(kim1->ctl->data, text, length + 1);
+	if (call(kim1, kim1_control_header::LEARN, row, 0) != 0)
+		return -1;
+	return kim1->ctl->length;
+}
+
+
+size_t kim1_save(kim1_instance *kim1, void *buffer, size_t size)
+{
+	if (call(kim1, kim1_control_header::SAVE, 0, 0) != 0 || kim1->ctl->length > size)
+		return 0;
+	memcpy(buffer, kim1->ctl->data, kim1->ctl->length);
+	return kim1->ctl->length;
+}
+
+
+int kim1_restore(kim1_instance *kim1, const void *snapshot, size_t length)
+{
+	if (length > kim1_control_header::DATA_SIZE)
+		return -1;
+	memcpy(kim1->ctl->data, snapshot, length);
+	return call(kim1, kim1_control_header::RESTORE, 0, length);
+}
@@ -0,0 +1,112 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    libkim1 - drive KIM-1 machines from a test service
+
+    Each instance is a `mame kim1 -video none` process of its own,
+    stopped between requests and driven through a shared control
+    object (see kim1_control_header in src/mame/machine/kim1_shm.h).
+    Any number of instances can be open at once; a handle is not
+    thread-safe, but different handles can be used from different
+    threads.
+
+    All functions returning int give 0 on success and -1 on failure.
+    libkim1_co.h adds C++20 coroutines that await the waits, many
+    machines at once from one thread.
+
+**********************************************************************/
+
+#ifndef MAME_TOOLS_LIBKIM1_LIBKIM1_H
+#define MAME_TOOLS_LIBKIM1_LIBKIM1_H
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct kim1_instance kim1_instance;
+
+/* keypad keys for kim1_set_keys, by row and port bit */
+#define KIM1_KEY(row, bit)  (1UL << ((row) * 7 + (bit)))
+#define KIM1_KEY_0          KIM1_KEY(0, 6)
+#define KIM1_KEY_GO         KIM1_KEY(2, 1)
+#define KIM1_KEY_AD         KIM1_KEY(2, 4)
+#define KIM1_KEY_DA         KIM1_KEY(2, 3)
+#define KIM1_KEY_PLUS       KIM1_KEY(2, 2)
+#define KIM1_KEY_PC         KIM1_KEY(2, 0)
+
+/* start a machine; mame is the emulator to run (found on the PATH if it
+   has no slash) and args, if not null, a null-terminated list of extra
+   options such as "-rompath" and its value; ROMs come from the rompath */
+kim1_instance *kim1_create(const char *mame, const char *const *args);
+
+/* stop the machine and free the handle */
+void kim1_destroy(kim1_instance *kim1);
+
+/* run for a number of cycles; slices of a thousand or so are cheap */
+int kim1_step(kim1_instance *kim1, uint32_t cycles);
+
+/* cycles run since the machine started */
+uint64_t kim1_cycles(kim1_instance *kim1);
+
+/* memory, as the CPU sees it; writes to ROM are ignored */
+int kim1_read(kim1_instance *kim1, uint16_t address, void *buffer, size_t length);
+int kim1_write(kim1_instance *kim1, uint16_t address, const void *buffer, size_t length);
+
+/* write a program and continue from its start */
+int kim1_load(kim1_instance *kim1, uint16_t address, const void *program, size_t length);
+int kim1_set_pc(kim1_instance *kim1, uint16_t pc);
+
+/* hold down the KIM1_KEY_* keys in mask, releasing the rest */
+int kim1_set_keys(kim1_instance *kim1, uint32_t mask);
+
+/* the video RAM at A000-BFFF, kept up to date after each call; serial,
+   if not null, is set to a number that changes with its contents */
+const uint8_t *kim1_framebuffer(kim1_instance *kim1, size_t *length, uint32_t *serial);
+
+/* an 80x50 greyscale thumbnail of the screen, one byte per 4x4 pixel
+   block, as of the last frame; serial is as for kim1_framebuffer */
+const uint8_t *kim1_thumbnail(kim1_instance *kim1, int *columns, int *rows, uint32_t *serial);
+
+/* run until an event, or until max_cycles have gone by (0 for no limit);
+   each returns 0 for the event, 1 for the limit and -1 on failure, and
+   stops the machine after the instruction that caused the event, so a
+   wait for a PC ends with the instruction there run; digits are up to
+   six hex digits from the left, with ? for any and space for blank */
+int kim1_wait_pc(kim1_instance *kim1, uint16_t pc, uint32_t max_cycles);
+int kim1_wait_leds(kim1_instance *kim1, const char *digits, uint32_t max_cycles);
+int kim1_wait_vram_write(kim1_instance *kim1, uint16_t start, uint16_t end, uint32_t max_cycles);
+
+/* the same, and kim1_step, without blocking: a kim1_start_* call posts
+   the request and returns 0, and kim1_poll then gives KIM1_BUSY while
+   the machine is running it and its result once it is done. Only one
+   request can be outstanding on a handle, and no other call can be made
+   on it meanwhile; many handles can be polled in turn from one thread */
+#define KIM1_BUSY           2
+int kim1_start_step(kim1_instance *kim1, uint32_t cycles);
+int kim1_start_wait_pc(kim1_instance *kim1, uint16_t pc, uint32_t max_cycles);
+int kim1_start_wait_leds(kim1_instance *kim1, const char *digits, uint32_t max_cycles);
+int kim1_start_wait_vram_write(kim1_instance *kim1, uint16_t start, uint16_t end, uint32_t max_cycles);
+int kim1_poll(kim1_instance *kim1);
+
+/* the screen as text: a row of the 40x25 character grid, with '?' for a
+   cell with no known glyph; kim1_text_learn teaches the glyphs on a row
+   from its known text, returning how many it learned */
+int kim1_text_row(kim1_instance *kim1, int row, char *buffer, size_t size);
+int kim1_text_learn(kim1_instance *kim1, int row, const char *text);
+
+/* a snapshot of the CPU and RAM; kim1_save returns its size, or 0 if it
+   does not fit in the buffer */
+size_t kim1_save(kim1_instance *kim1, void *buffer, size_t size);
+int kim1_restore(kim1_instance *kim1, const void *snapshot, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MAME_TOOLS_LIBKIM1_LIBKIM1_H
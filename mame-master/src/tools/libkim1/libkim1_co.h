@@ -0,0 +1,273 @@
+// license:GPL-2.0+
+// copyright-holders:mkelsey
+/**********************************************************************
+
+    libkim1 coroutines - write KIM-1 tests as C++20 coroutines
+
+    A test is a kim1::task coroutine that awaits emulated events:
+
+        kim1::task boots()
+        {
+            co_await kim1::cycles(1'000'000);
+            bool shown = co_await kim1::led_shows("0000", 2'000'000);
+            if (!shown)
+                throw std::runtime_error("monitor did not start");
+            co_await kim1::pc_reached(0x1c4f);
+        }
+
+        kim1_instance *machine = kim1_create("mame", nullptr);
+        boots().run(machine);
+
+    Each co_await posts the request to the machine and suspends the
+    coroutine. A kim1::runner polls the machines of all its tasks in
+    turn and resumes each coroutine once its machine has stopped, after
+    the instruction that caused the event, so tests on many machines
+    run side by side on one thread:
+
+        kim1::runner runner;
+        runner.add(boots(), machine_a);
+        runner.add(boots(), machine_b);
+        runner.run();
+
+    An await gives true for the event and false if its cycle limit ran
+    out first (0, the default, is none). A failed request, such as the
+    machine having gone, throws kim1::error out of the coroutine, and
+    the first task to fail has its exception rethrown by run() once the
+    rest have finished.
+
+    Only built where the compiler supports coroutines; the rest of
+    libkim1 is plain C. GCC 12 miscompiles a co_await used directly as
+    an if condition, so take the result into a variable first.
+
+**********************************************************************/
+
+#ifndef MAME_TOOLS_LIBKIM1_LIBKIM1_CO_H
+#define MAME_TOOLS_LIBKIM1_LIBKIM1_CO_H
+
+#pragma once
+
+#include "libkim1.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace kim1 {
+
+//**************************************************************************
+//  EVENTS
+//**************************************************************************
+
+// kept trivially destructible; some compilers mishandle the lifetime of
+// temporaries in a co_await expression that have destructors
+struct cycles
+{
+	cycles(uint32_t count) : count(count) { }
+	uint32_t count;
+};
+
+struct pc_reached
+{
+	pc_reached(uint16_t pc, uint32_t max_cycles = 0) : pc(pc), max_cycles(max_cycles) { }
+	uint16_t pc;
+	uint32_t max_cycles;
+};
+
+struct led_shows
+{
+	led_shows(const char *shown, uint32_t max_cycles = 0) : digits(), max_cycles(max_cycles) { strncpy(digits, shown, 6); }
+	char digits[7];
+	uint32_t max_cycles;
+};
+
+struct vram_write
+{
+	vram_write(uint16_t start, uint16_t end, uint32_t max_cycles = 0) : start(start), end(end), max_cycles(max_cycles) { }
+	uint16_t start, end;
+	uint32_t max_cycles;
+};
+
+class error : public std::runtime_error
+{
+public:
+	using std::runtime_error::runtime_error;
+};
+
+
+//**************************************************************************
+//  TASK
+//**************************************************************************
+
+class task
+{
+public:
+	struct promise_type;
+
+	// the request is posted in await_suspend and the coroutine stays
+	// suspended until the runner sees the machine finish it; one that
+	// cannot be posted carries straight on to throw
+	template <typename Request>
+	class awaiter
+	{
+	public:
+		awaiter(promise_type &promise, Request request) : m_promise(promise), m_request(std::move(request)) { }
+
+		bool await_ready() const noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<>)
+		{
+			if (m_request(m_promise.machine) != 0)
+				return false;
+			m_promise.result = &m_result;
+			return true;
+		}
+		bool await_resume() const
+		{
+			if (m_result < 0)
+				throw error("KIM-1 machine request failed");
+			return m_result == 0;
+		}
+
+	private:
+		promise_type &m_promise;
+		Request m_request;
+		int m_result = -1;
+	};
+
+	struct promise_type
+	{
+		kim1_instance *machine = nullptr;
+		int *result = nullptr;          // where the outstanding request's result goes
+		std::exception_ptr failure;
+
+		task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return { }; }
+		std::suspend_always final_suspend() noexcept { return { }; }
+		void return_void() { }
+		void unhandled_exception() { failure = std::current_exception(); }
+
+		auto await_transform(cycles event)
+		{
+			return make_awaiter([event] (kim1_instance *k) { return kim1_start_step(k, event.count); });
+		}
+		auto await_transform(pc_reached event)
+		{
+			return make_awaiter([event] (kim1_instance *k) { return kim1_start_wait_pc(k, event.pc, event.max_cycles); });
+		}
+		auto await_transform(led_shows event)
+		{
+			return make_awaiter([event] (kim1_instance *k) { return kim1_start_wait_leds(k, event.digits, event.max_cycles); });
+		}
+		auto await_transform(vram_write event)
+		{
+			return make_awaiter([event] (kim1_instance *k) { return kim1_start_wait_vram_write(k, event.start, event.end, event.max_cycles); });
+		}
+
+	private:
+		template <typename Request>
+		awaiter<Request> make_awaiter(Request request) { return awaiter<Request>(*this, std::move(request)); }
+	};
+
+	task(task &&that) noexcept : m_handle(std::exchange(that.m_handle, nullptr)) { }
+	task(const task &) = delete;
+	task &operator=(const task &) = delete;
+	~task() { if (m_handle) m_handle.destroy(); }
+
+	// run the test on a machine to the end, rethrowing what it threw
+	inline void run(kim1_instance *machine);
+
+private:
+	friend class runner;
+
+	explicit task(std::coroutine_handle<promise_type> handle) : m_handle(handle) { }
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+
+//**************************************************************************
+//  RUNNER
+//**************************************************************************
+
+class runner
+{
+public:
+	// a task to start on a machine when the runner runs
+	void add(task &&test, kim1_instance *machine)
+	{
+		test.m_handle.promise().machine = machine;
+		m_tasks.push_back(std::move(test));
+	}
+
+	// start every task, then resume each as its machine finishes its
+	// request, until all have returned
+	void run()
+	{
+		std::vector<std::coroutine_handle<task::promise_type>> waiting;
+		for (task &test : m_tasks)
+			if (step(test.m_handle))
+				waiting.push_back(test.m_handle);
+
+		int idle = 0;
+		while (!waiting.empty())
+		{
+			bool progress = false;
+			for (auto it = waiting.begin(); it != waiting.end(); )
+			{
+				int const result = kim1_poll(it->promise().machine);
+				if (result == KIM1_BUSY)
+				{
+					++it;
+					continue;
+				}
+				*it->promise().result = result;
+				progress = true;
+				it = step(*it) ? it + 1 : waiting.erase(it);
+			}
+
+			/* the machines run in processes of their own; spin briefly,
+			   then sleep, while they do */
+			if (progress)
+				idle = 0;
+			else if (++idle < 1000)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::microseconds(20));
+		}
+
+		for (task &test : m_tasks)
+			if (test.m_handle.promise().failure)
+				std::rethrow_exception(test.m_handle.promise().failure);
+	}
+
+private:
+	// resume a task; true if it has posted a request and is waiting
+	static bool step(std::coroutine_handle<task::promise_type> handle)
+	{
+		handle.promise().result = nullptr;
+		handle.resume();
+		return !handle.done();
+	}
+
+	std::vector<task> m_tasks;
+};
+
+
+inline void task::run(kim1_instance *machine)
+{
+	runner single;
+	single.add(std::move(*this), machine);
+	single.run();
+}
+
+} // namespace kim1
+
+#endif // __cpp_impl_coroutine
+
+#endif // MAME_TOOLS_LIBKIM1_LIBKIM1_CO_H